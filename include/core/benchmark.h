@@ -0,0 +1,36 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+/*
+* Frame statistics of a benchmark run
+* @scene: name of the scene, written in the report
+* @num_frames: number of frames to record
+*/
+bool start_benchmark(const char* scene, int width, int height, int num_frames);
+
+
+/*
+* Record one frame
+* @frame_time: update() and render() of the frame, in milliseconds
+* @num_triangles: triangles sent to the rasterizer
+* @num_pixels: pixels drawn over the background
+* @frame_memory: bytes taken from the frame arena
+* @num_allocations: arena chunks allocated during the frame (0 in steady state)
+*/
+void record_benchmark_frame(double frame_time, int num_triangles, int num_pixels, size_t frame_memory, int num_allocations);
+
+
+/*
+* Write the report as JSON: mean, median, p95 and p99 frame times, the frame
+* memory high water mark and chunk allocations, then every frame
+* @path: output file, stdout when NULL
+*/
+bool write_benchmark_report(const char* path);
+
+void free_benchmark(void);
+
+#endif // !BENCHMARK_H
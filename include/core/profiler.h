@@ -0,0 +1,68 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// On in debug builds, compiled out of the release builds unless built with profile=1
+#if !defined(NDEBUG) || defined(PROFILE)
+#define PROFILER_ON
+#endif
+
+/*
+* Stages of a frame, in the order of the graphic pipeline
+* The tile stages (clear, raster) are summed over the workers: CPU time, not wall time
+*/
+typedef enum {
+    STAGE_MATRICES,          // World, view and model-view matrices
+    STAGE_VERTEX_TRANSFORM,  // Every vertex of the meshes to camera space
+    STAGE_CULLING,
+    STAGE_CLIPPING,
+    STAGE_PROJECTION,
+    STAGE_EMISSION,      // Shading and storing the triangles for the renderer
+    STAGE_BINNING,       // Visibility / wireframe preparation and tile binning
+    STAGE_CLEAR,
+    STAGE_RASTER,
+    STAGE_SHADING,       // Visibility buffer resolve
+    STAGE_PRESENT,
+    NUM_STAGES
+} profile_stage_t;
+
+#ifdef PROFILER_ON
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define profiler_ticks() __rdtsc()
+#else
+#include <SDL2/SDL.h>
+#define profiler_ticks() SDL_GetPerformanceCounter()
+#endif
+
+// Scoped timer: PROFILE_BEGIN(stage) and PROFILE_END(stage) in the same block, any thread
+#define PROFILE_BEGIN(stage) uint64_t profile_start_##stage = profiler_ticks()
+#define PROFILE_END(stage) profiler_add((stage), profiler_ticks() - profile_start_##stage)
+#define PROFILE_FRAME_END() profiler_end_frame()
+#define PROFILE_INITIALIZE() profiler_initialize()
+#else
+#define PROFILE_BEGIN(stage) ((void)0)
+#define PROFILE_END(stage) ((void)0)
+#define PROFILE_FRAME_END() ((void)0)
+#define PROFILE_INITIALIZE() ((void)0)
+#endif
+
+// Frames kept in the ring buffer, also the period of the rolling summary
+#define PROFILER_HISTORY 120
+
+// Calibrate the ticks against the SDL counter: once, outside of the measured frames (waits 10 ms)
+void profiler_initialize(void);
+void profiler_add(profile_stage_t stage, uint64_t ticks);
+// Close the frame: its stage times go in the ring buffer
+void profiler_end_frame(void);
+
+// Print the mean of each stage over the ring buffer every PROFILER_HISTORY frames
+void set_profile_summary(bool is_printed);
+bool get_profile_summary(void);
+void print_profile_summary(void);
+// Stage times in ms of the frames in the ring buffer, oldest first
+bool save_profile_csv(const char* path);
+
+#endif // !PROFILER_H
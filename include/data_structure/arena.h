@@ -0,0 +1,58 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+* Linear allocator
+* ----------------
+* Allocations are carved one after the other in chunks; nothing is freed on
+* its own, the whole arena is reset at once. A reset keeps the chunks: once
+* the arena has grown to the size of a frame, a frame does no malloc.
+*/
+#define ARENA_ALIGNMENT 16
+#define ARENA_CHUNK_SIZE (1 << 20)
+
+typedef struct arena_chunk arena_chunk_t;
+
+typedef struct {
+    arena_chunk_t* first;
+    arena_chunk_t* current;
+    size_t used;              // Bytes handed out since the last reset
+    size_t reserved;          // Bytes of all the chunks
+    int num_chunk_allocations;// Calls to malloc since the creation
+} arena_t;
+
+// NULL if malloc failed
+void* arena_alloc(arena_t* arena, size_t size);
+void arena_reset(arena_t* arena);
+void arena_free(arena_t* arena);
+
+/*
+* Frame arena
+* -----------
+* One sub-arena per OpenMP thread: the workers allocate without any lock.
+* Memory handed out during a frame is valid until the next reset.
+*/
+typedef struct {
+    size_t used;                // Bytes of the last frame, all threads
+    size_t high_water_mark;     // Largest frame since the creation
+    size_t reserved;            // Bytes of all the chunks, all threads
+    int num_chunk_allocations;  // Calls to malloc since the creation
+} arena_stats_t;
+
+typedef struct {
+    arena_t* threads;
+    int num_threads;
+    size_t high_water_mark;
+} frame_arena_t;
+
+void initialize_frame_arena(frame_arena_t* frame_arena);
+// Record the high water mark, then forget every allocation of the frame
+void reset_frame_arena(frame_arena_t* frame_arena);
+// Sub-arena of the calling thread (of the main thread outside of a parallel region)
+arena_t* get_thread_arena(frame_arena_t* frame_arena);
+arena_stats_t get_frame_arena_stats(const frame_arena_t* frame_arena);
+void free_frame_arena(frame_arena_t* frame_arena);
+
+#endif // !ARENA_H
@@ -24,5 +24,7 @@ mat4_t mat4_mult(mat4_t a, mat4_t b);
 mat4_t expimental__mat4_mult_fast(mat4_t a, mat4_t b);
 vec4_t mat4_mult_vec4(mat4_t m, vec4_t v);
 vec4_t expimental__mat4_mult_vec4_fast(mat4_t m, vec4_t v);
+// out[i] = m * in[i] for n vertices (in and out must not overlap)
+void   mat4_mult_vec4_batch(const mat4_t* m, const vec4_t* in, vec4_t* out, int n);
 
 #endif // !MATRIX_H
@@ -0,0 +1,38 @@
+#ifndef VERTEX_STREAM_H
+#define VERTEX_STREAM_H
+
+#include "vector.h"
+#include <stdbool.h>
+
+/*
+* Structure of arrays: one stream per coordinate, aligned and padded with
+* zeros up to a multiple of VERTEX_STREAM_WIDTH, so the SIMD loops load
+* whole registers and never need a tail
+*/
+#define VERTEX_STREAM_WIDTH 8
+#define VERTEX_STREAM_ALIGNMENT 32
+
+typedef struct {
+    float* x;
+    float* y;
+    float* z;
+    float* w;      // NULL when the stream has no w (w = 1)
+    int count;     // Number of vertices
+    int capacity;  // count padded to VERTEX_STREAM_WIDTH
+} vertex_stream_t;
+
+vertex_stream_t create_vertex_stream(int count, bool has_w);
+vertex_stream_t create_vertex_stream_from_vec3(const vec3_t* vertices, int count);
+void free_vertex_stream(vertex_stream_t* stream);
+
+static inline vec3_t get_vertex_stream_vec3(const vertex_stream_t* stream, int index) {
+    return (vec3_t){ stream->x[index], stream->y[index], stream->z[index] };
+}
+
+static inline void set_vertex_stream_vec3(vertex_stream_t* stream, int index, vec3_t v) {
+    stream->x[index] = v.x;
+    stream->y[index] = v.y;
+    stream->z[index] = v.z;
+}
+
+#endif // !VERTEX_STREAM_H
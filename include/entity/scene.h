@@ -0,0 +1,21 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <stdbool.h>
+
+
+/*
+* Load the meshes of a named scene and put the camera at the start of its path
+* @name: "planes", "cube", "sphere" or "teapot"
+* Return false if the scene is unknown
+*/
+bool load_scene(const char* name);
+
+
+/*
+* Move the camera along the scripted path of the loaded scene
+* @t: position on the path, one orbit around the scene from 0 to 1
+*/
+void update_scene_camera(float t);
+
+#endif // !SCENE_H
@@ -3,6 +3,7 @@
 
 #include "matrix.h"
 #include "vector.h"
+#include <stdbool.h>
 
 typedef struct {
     vec3_t position;
@@ -10,6 +11,9 @@ typedef struct {
     vec3_t forward_velocity;
     float  yaw_angle;
     float  pitch_angle;
+    mat4_t view_matrix;     // Cached: only rebuilt when the position, yaw or pitch changed
+    bool   is_view_dirty;
+    int    view_version;    // Incremented at each rebuild of the view matrix
 } camera_t;
 
 typedef enum { TARGET, FPS } camera_mode;
@@ -33,4 +37,9 @@ void rotate_camera_pitch(float angle);
 
 vec3_t get_camera_lookat_target(void);
 
+// View matrix of the camera, rebuilt only if it moved since the last call
+mat4_t get_camera_view_matrix(void);
+// Changes each time the view matrix is rebuilt: caches derived from it compare it
+int get_camera_view_version(void);
+
 #endif // !CAMERA_H
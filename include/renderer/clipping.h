@@ -11,7 +11,8 @@ enum {
     TOP_FRUSTUM_PLANE,
     BOTTOM_FRUSTUM_PLANE,
     NEAR_FRUSTUM_PLANE,
-    FAR_FRUSTUM_PLANE
+    FAR_FRUSTUM_PLANE,
+    NUM_FRUSTUM_PLANES
 };
 
 typedef struct{
@@ -32,10 +33,11 @@ polygon_t create_polygon(vec3_t* triangle_vertices);
 void clip_polygon(polygon_t* polygon);
 
 void initialize_frustum_planes(float fovy, float fovx, float z_near, float z_far);
+plane_t get_frustum_plane(int plane_index);
 polygon_t create_polygon_from_triangle(
     vec3_t v0, vec3_t v1, vec3_t v2,
     tex2_t uv0, tex2_t uv1, tex2_t uv2);
-void create_triangles_from_polygon(polygon_t* polygon, triangle_t* clipped_triangles, int* num_clipped_triangles, upng_t* texture);
+void create_triangles_from_polygon(polygon_t* polygon, triangle_t* clipped_triangles, int* num_clipped_triangles, texture_t* texture);
 
 
 #endif // !CLIPPING_H
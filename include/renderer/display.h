@@ -1,7 +1,6 @@
 #ifndef DISPLAY_H
 #define DISPLAY_H
 
-#include "triangle.h"
 #include "vector.h"
 #include <stdint.h>
 #include <stdbool.h>
@@ -10,36 +9,120 @@
 #define FPS 60
 #define FRAME_TARGET_TIME (1000.0 / FPS)
 
+// Reference dots of the background
+#define REF_SPACING 20
+#define REF_COLOR 0xFF333333
+
 enum rendering_mode { WIREFRAME,
     WIREFRAME_AND_VERTEX,
     TRIANGLE,
     TRIANGLE_AND_WIREFRAME, 
     TEXTURE,
     TEXTURE_AND_WIREFRAME,
+    VISIBILITY_BUFFER,
 };
 enum culling_mode { CULLING_ON, CULLING_OFF };
 enum light_mode { LIGHT_ON, LIGHT_OFF };
+enum simd_mode { SIMD_ON, SIMD_OFF };
+enum subpixel_mode { SUBPIXEL_ON, SUBPIXEL_OFF };
+enum mapping_mode { MAPPING_PERSPECTIVE, MAPPING_AFFINE_SPAN };
+enum mipmap_mode { MIPMAP_ON, MIPMAP_OFF };
+enum filter_mode { FILTER_NEAREST, FILTER_BILINEAR };
+/*
+* Depth buffer formats, smaller is closer except for the reversed one
+* DEPTH_FLOAT:          1 - 1/w as a float
+* DEPTH_UNORM16:        depth between the near and far planes on 16 bits
+* DEPTH_UNORM24:        same on 24 bits, in 32 bits words (8 bits spare for a stencil)
+* DEPTH_REVERSED_FLOAT: 1/w as a float, bigger is closer (float precision where w is big)
+*/
+enum depth_format { DEPTH_FLOAT, DEPTH_UNORM16, DEPTH_UNORM24, DEPTH_REVERSED_FLOAT };
+/*
+* How a frame reaches the screen
+* PRESENT_LOCK_TEXTURE:   drawn straight into the locked SDL texture
+* PRESENT_UPDATE_TEXTURE: drawn into a buffer copied at present
+* PRESENT_PIPELINED:      drawn by the raster thread while the previous frame is presented
+*/
+enum present_mode { PRESENT_LOCK_TEXTURE, PRESENT_UPDATE_TEXTURE, PRESENT_PIPELINED };
+// Where the frames go: an SDL window, or only memory (no SDL video, for servers and CI)
+enum display_backend { BACKEND_WINDOW, BACKEND_OFFSCREEN };
+
+typedef uint32_t color_t;  // 0xAARRGGBB
+
+// Inclusive pixel rectangle
+typedef struct {
+    int x_min, y_min, x_max, y_max;
+} rect_t;
 
-typedef uint32_t color_t;
+// Maps 1/w to the unorm depth formats: (near_inverse - 1/w) * scale is in [0, 1]
+typedef struct {
+    float near_inverse;
+    float scale;
+} depth_range_t;
+
+/*
+* Raster settings of a frame
+* Captured once by render() and passed down the raster path: the tile workers
+* (on the raster thread when pipelined) never read the toggles, which the
+* input can change while the frame is drawn
+*/
+typedef struct {
+    int simd_mode;
+    int subpixel_mode;
+    int mapping_mode;
+    int mipmap_mode;
+    int filter_mode;
+    int depth_format;
+    depth_range_t depth_range;
+} raster_settings_t;
 
 // Function ////////////////////////////////////////////////
 bool initialize_window(bool is_fullscreen, bool is_retro_look);
+// Offscreen backend: only the buffers, at the requested size
+bool initialize_offscreen(int width, int height);
 void destroy_window(void);
 
+// Clipping ///////////////////////////////////////////////
+// Per thread: a worker drawing a tile only touches the pixels it owns
+void set_clip_rect(rect_t rect);
+void reset_clip_rect(void);
+rect_t get_clip_rect(void);
+
 // Drawing ////////////////////////////////////////////////
-void draw_grid(void);
-void draw_ref(void);
 void draw_pixel(int x, int y, color_t color);
 void draw_rec(int x, int y, int w, int h, color_t color);
-void draw_line(vec2_t start, vec2_t end, color_t color);
-void draw_triangle(triangle_t triangle, color_t color);
 
 // Rendering //////////////////////////////////////////////
-void clear_color_buffer(color_t color);
+// Before drawing a frame: color buffer of the frame (the SDL texture itself if it can be locked)
+void prepare_color_buffer(void);
+// Hand the color buffer to SDL and present it
 void render_color_buffer(void);
-void clear_z_buffer(void);
-float get_z_buffer(int x, int y);
-void update_z_buffer(int x, int y, float z);
+/*
+* Draw a frame with draw_frame(data) and present it, according to the present mode
+* Pipelined, draw_frame() runs on the raster thread and the frame is presented on the next call:
+* data must stay untouched until then.
+*/
+void render_frame(void (*draw_frame)(void*), void* data);
+// Wait for the frame in flight and present it: the last frame drawn is then the presented one
+void finish_frame(void);
+// Wait for the frame in flight and join the raster thread (done by destroy_window())
+void stop_raster_thread(void);
+// Last frame presented, window_width pixels per row (NULL when it went straight to the SDL texture)
+color_t* get_presented_frame(void);
+bool save_frame_ppm(const char* path);
+// Pixels of the presented frame that differ from the background cleared with clear_color
+int count_drawn_pixels(color_t clear_color);
+/*
+* Background of a rect: color, reference dots and far depth
+* clear_rect() leaves the lines in cache (the tile is drawn next),
+* stream_clear_rect() bypasses the cache (nothing is drawn in the rect).
+*/
+void clear_rect(rect_t rect, color_t color, int depth_format);
+void stream_clear_rect(rect_t rect, color_t color, int depth_format);
+// Raw rows for the rasterizer: no bounds check, caller stays in the viewport
+color_t* get_color_buffer_row(int y);
+// float, uint16_t or uint32_t per pixel depending on the depth format
+void* get_z_buffer_row(int y, int depth_format);
+uint32_t* get_id_buffer_row(int y);
 
 // Getter / Setter /////////////////////////////////////////
 int get_window_height(void);
@@ -51,6 +134,25 @@ void set_current_light_mode(int light_mode);
 int get_current_light_mode(void);
 void set_culling_mode(int culling_mode);
 int get_culling_mode(void);
+void set_simd_mode(int simd_mode);
+int get_simd_mode(void);
+void set_subpixel_mode(int subpixel_mode);
+int get_subpixel_mode(void);
+void set_mapping_mode(int mapping_mode);
+int get_mapping_mode(void);
+void set_mipmap_mode(int mipmap_mode);
+int get_mipmap_mode(void);
+void set_filter_mode(int filter_mode);
+int get_filter_mode(void);
+void set_depth_format(int depth_format);
+int get_depth_format(void);
+void set_depth_range(float z_near, float z_far);
+depth_range_t get_depth_range(void);
+// Current value of the toggles above, for the next frame
+raster_settings_t get_raster_settings(void);
+void set_present_mode(int present_mode);
+int get_present_mode(void);
+int get_display_backend(void);
 
 
 #endif // DISPLAY_H
@@ -0,0 +1,34 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "matrix.h"
+#include "triangle.h"
+#include "vertex_stream.h"
+#include <stdint.h>
+
+/*
+* Vertex stage kernels
+* --------------------
+* Work on the SoA streams of a mesh, 8 vertices (or faces) per AVX2 register.
+* Every lane does the same operations in the same order as the scalar code of
+* the pipeline (mat4_mult_vec4, get_triangle_normal, clip_polygon and
+* mat4_mul_vec4_project): the output is bit for bit equal with SIMD on or off.
+*/
+
+// Bit i set: the vertex is not strictly inside frustum plane i
+typedef uint8_t clip_flags_t;
+
+// MODEL SPACE -> CAMERA SPACE: out = m * (x, y, z, 1)
+void transform_vertex_stream(const mat4_t* m, const vertex_stream_t* in, vertex_stream_t* out);
+
+// CAMERA SPACE -> SCREEN SPACE: out needs a w stream, clip_flags one byte per vertex of the capacity
+void project_vertex_stream(
+    const mat4_t* projection, const vertex_stream_t* in, vertex_stream_t* out,
+    clip_flags_t* clip_flags, int width, int height);
+
+// Normal of each face (as get_triangle_normal) and whether it faces the camera
+void compute_face_normals(
+    const face_t* faces, int num_faces, const vertex_stream_t* vertices,
+    vertex_stream_t* normals, bool* is_front_face);
+
+#endif // !GEOMETRY_H
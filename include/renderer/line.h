@@ -0,0 +1,29 @@
+#ifndef LINE_H
+#define LINE_H
+
+#include "display.h"
+#include "triangle.h"
+#include "vector.h"
+
+/*
+* Line rasterizer for the wireframe modes
+* ---------------------------------------
+* Lines are clipped to the clip rect (viewport or tile) before the first
+* step, with exact integer math: a line cut by a tile border keeps the same
+* pixels as the full line. Pixels are written through the row pointers.
+*/
+void draw_line(vec2_t start, vec2_t end, color_t color);
+// The 3 edges of the triangle
+void draw_triangle(triangle_t triangle, color_t color);
+
+/*
+* Wireframe of a mesh: an edge shared by two triangles is drawn once
+* The last triangle of the frame using an edge owns it (it was drawn last
+* before, so the colors do not change).
+*/
+void prepare_wireframe(triangle_t* triangles, int num_triangles);
+// Only the edges owned by the triangle, in the clip rect (tile callback)
+void draw_wireframe_triangle(triangle_t* triangle, color_t color);
+void free_wireframe(void);
+
+#endif // !LINE_H
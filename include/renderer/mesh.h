@@ -2,23 +2,46 @@
 #define MESH_H
 
 #include "display.h"
-#include "upng.h"
+#include "geometry.h"
+#include "matrix.h"
+#include "texture.h"
 #include "vector.h"
 #include "triangle.h"
+#include "vertex_stream.h"
 
 // This would be equivalent of a "Game Object"
 typedef struct {
-    vec3_t* vertices;  // Dynamic array of vertices   |
+    vertex_stream_t vertices; // Model space, built by the OBJ loader |
     face_t* faces;     // Dynamic array of faces      |
-    upng_t *texture;   // Texture for the mesh        |
+    texture_t* texture;// Texture for the mesh        |
     vec3_t rotation;   // Rotation with xyz value     |
     vec3_t scale;      // Scale with xyz value        |
     vec3_t translation;// Translation with xyz value  |
+    // Cached matrices: only rebuilt when the mesh or the camera moved
+    mat4_t world_matrix;
+    mat4_t model_view_matrix;
+    bool is_world_dirty;     // Scale, rotation or translation changed
+    int view_version;        // Camera view in model_view_matrix, -1 if never built
+    // Vertex stage output: rebuilt only when model_view_matrix changed
+    vertex_stream_t camera_vertices;
+    vertex_stream_t screen_vertices; // x, y in pixels, z / w and w
+    clip_flags_t* clip_flags;        // Per vertex, see geometry.h
+    vertex_stream_t face_normals;    // Per face, in camera space
+    bool* is_front_face;             // Per face, false if back face culling prunes it
 } mesh_t;
 
 void load_mesh(char* obj_filename, char* png_filename, vec3_t scaling, vec3_t translation, vec3_t rotation);
 void load_mesh_and_data_from_obj(mesh_t* mesh, char* filename);
 void load_mesh_png_texture(mesh_t* mesh, char* filename);
+// Setters of the transform: keep the cached matrices in sync
+void set_mesh_scale(mesh_t* mesh, vec3_t scale);
+void set_mesh_rotation(mesh_t* mesh, vec3_t rotation);
+void set_mesh_translation(mesh_t* mesh, vec3_t translation);
+/*
+* Rebuild the world and model-view matrices if the mesh or the camera moved
+* Return true if model_view_matrix changed (the camera space vertices are stale)
+*/
+bool update_mesh_matrices(mesh_t* mesh, mat4_t view_matrix, int view_version);
 int get_num_meshes();
 mesh_t* get_mesh(int mesh_idx);
 void free_meshes();
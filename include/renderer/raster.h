@@ -0,0 +1,158 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "display.h"
+#include "texture.h"
+#include "triangle.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+* Triangle ready to be walked by a raster kernel
+* Edge i is the one facing the vertex i, the edge functions are integer so
+* any kernel (scalar or SIMD) finds the exact same coverage.
+*/
+typedef struct {
+    int x_min, y_min, x_max, y_max;  // Bounding box clamped to the clip rect
+    int w_row[3];                    // Edge functions at (x_min, y_min)
+    int step_x[3];                   // Edge function increment for x + 1
+    int step_y[3];                   // Edge function increment for y + 1
+    int threshold[3];                // 0 for top-left edges, 1 otherwise
+    int vertex_order[3];             // Original vertex index of each corner
+    int area;                        // Sum of the 3 edge functions
+    int x_anchor, y_anchor;          // Pixel of the first vertex
+    int w_anchor[3];                 // Edge functions at the anchor pixel
+} raster_setup_t;
+
+/*
+* Attribute interpolated linearly in screen space: value = origin + dx * x + dy * y
+* Set up once per triangle, relative to the anchor pixel. It only depends on
+* the triangle (not on the clip rect): a tile or a SIMD lane gets the exact
+* same value for a pixel.
+*/
+typedef struct {
+    float origin;  // Value at the anchor pixel
+    float dx, dy;  // Gradient per pixel
+} attribute_plane_t;
+
+/*
+* Compute the bounding box (clamped to the clip rect) and the edge functions
+* Return false if nothing has to be drawn (degenerated or off screen)
+*/
+bool setup_triangle(const triangle_t* triangle, raster_setup_t* setup, const raster_settings_t* settings);
+
+// values: attribute of each corner, in the order of the edges
+attribute_plane_t setup_attribute_plane(const raster_setup_t* setup, const float values[3]);
+
+/*
+* Mipmap level of a textured triangle (level 0 when the mipmaps are off)
+* Picked where the texture is the most magnified, so no pixel of the triangle
+* gets a blurrier level than it needs.
+*/
+const texture_level_t* select_texture_level(const triangle_t* triangle, const raster_settings_t* settings);
+
+// Value at the start of the row y_offset = y - y_anchor, then add dx * (x - x_anchor)
+static inline float attribute_plane_row(const attribute_plane_t* plane, int y_offset) {
+    return plane->origin + plane->dy * (float)y_offset;
+}
+
+// Depth formats ==============================================================
+
+/*
+* Loops specialised per depth format: always inlined in each case of
+* DEPTH_FORMAT_DISPATCH, so the format is a constant and the switch of
+* depth_test() is folded out of the inner loop.
+*/
+#if defined(__GNUC__)
+#define SPECIALISED static inline __attribute__((always_inline))
+#else
+#define SPECIALISED static inline
+#endif
+
+// Call function(..., format) with the format as a constant
+#define DEPTH_FORMAT_DISPATCH(format, function, ...)                           \
+    switch (format) {                                                         \
+        case DEPTH_UNORM16: function(__VA_ARGS__, DEPTH_UNORM16); break;      \
+        case DEPTH_UNORM24: function(__VA_ARGS__, DEPTH_UNORM24); break;      \
+        case DEPTH_REVERSED_FLOAT: function(__VA_ARGS__, DEPTH_REVERSED_FLOAT); break; \
+        default: function(__VA_ARGS__, DEPTH_FLOAT); break;                   \
+    }
+
+#define DEPTH_UNORM16_MAX 65535.0f
+#define DEPTH_UNORM24_MAX 16777215.0f
+
+// Depth in [0, max - 1]: max is the clear value, never written by a triangle
+static inline uint32_t encode_unorm_depth(float reciprocal_w, const depth_range_t* range, float max) {
+    float depth = (range->near_inverse - reciprocal_w) * range->scale;
+    depth = depth > 0.0f ? depth : 0.0f;
+    depth = depth < 1.0f ? depth : 1.0f;
+    uint32_t value = (uint32_t)(depth * max + 0.5f);
+    return value < (uint32_t)max ? value : (uint32_t)max - 1;
+}
+
+// Depth test of a pixel from the interpolated 1/w, the depth is written when it passes
+static inline bool depth_test(void* z_row, int x, float reciprocal_w, const depth_range_t* range, int format) {
+    switch (format) {
+        case DEPTH_UNORM16: {
+            uint16_t* z = (uint16_t*)z_row;
+            uint16_t depth = (uint16_t)encode_unorm_depth(reciprocal_w, range, DEPTH_UNORM16_MAX);
+            if (depth >= z[x]) return false;
+            z[x] = depth;
+            return true;
+        }
+        case DEPTH_UNORM24: {
+            uint32_t* z = (uint32_t*)z_row;
+            uint32_t depth = encode_unorm_depth(reciprocal_w, range, DEPTH_UNORM24_MAX);
+            if (depth >= z[x]) return false;
+            z[x] = depth;
+            return true;
+        }
+        case DEPTH_REVERSED_FLOAT: {
+            float* z = (float*)z_row;
+            if (!(reciprocal_w > z[x])) return false;
+            z[x] = reciprocal_w;
+            return true;
+        }
+        default: {
+            float* z = (float*)z_row;
+            float depth = 1.0f - reciprocal_w;
+            if (!(depth < z[x])) return false;
+            z[x] = depth;
+            return true;
+        }
+    }
+}
+
+// Still the clear value: no triangle covers the pixel
+static inline bool depth_is_cleared(const void* z_row, int x, int format) {
+    switch (format) {
+        case DEPTH_UNORM16: return ((const uint16_t*)z_row)[x] == (uint16_t)DEPTH_UNORM16_MAX;
+        case DEPTH_UNORM24: return ((const uint32_t*)z_row)[x] == (uint32_t)DEPTH_UNORM24_MAX;
+        case DEPTH_REVERSED_FLOAT: return ((const float*)z_row)[x] <= 0.0f;
+        default: return ((const float*)z_row)[x] >= 1.0f;
+    }
+}
+
+// SIMD kernels ===============================================================
+
+// 8 pixels at a time, same output as the scalar loops
+bool raster_has_avx2(void);
+void raster_flat_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, color_t color,
+    const depth_range_t* depth_range, int depth_format);
+void raster_visibility_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, uint32_t id,
+    const depth_range_t* depth_range, int depth_format);
+void raster_textured_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w,
+    const attribute_plane_t* u_w, const attribute_plane_t* v_w,
+    const texture_level_t* texture, bool is_bilinear, float light_intensity,
+    const depth_range_t* depth_range, int depth_format);
+
+// AVX2 has no 16 bits masked store: the 16 bits depth always takes the scalar loops
+static inline bool raster_use_avx2(const raster_settings_t* settings) {
+    return settings->simd_mode == SIMD_ON && settings->depth_format != DEPTH_UNORM16 && raster_has_avx2();
+}
+
+#endif // !RASTER_H
@@ -2,12 +2,89 @@
 #define TEXTURE_H
 
 #include "upng.h"
+#include <math.h>
 #include <stdint.h>
 
 typedef struct {
     float u, v;
 } tex2_t;
 
+/*
+* Texture ready for the rasterizer
+* --------------------------------
+* Power of two sized (resampled at load time) so the wrap is a mask, and
+* stored in 4x4 texel blocks: a block is one cache line, so walking the
+* texture along a column (oblique runway, fuselage) stays in cache.
+*/
+#define TEXTURE_BLOCK_BITS 2
+#define TEXTURE_BLOCK_SIZE (1 << TEXTURE_BLOCK_BITS)
+// Enough levels for a 65536 texels wide texture
+#define TEXTURE_MAX_LEVELS 16
+
+typedef struct {
+    uint32_t* texels;  // Blocks of 4x4 texels, row of blocks after row of blocks
+    int width;         // Power of two, at least TEXTURE_BLOCK_SIZE
+    int height;        // Power of two, at least TEXTURE_BLOCK_SIZE
+    int width_shift;   // log2(width)
+} texture_level_t;
+
+/*
+* Mipmap chain: each level is the previous one box filtered to half the size,
+* down to a width or height of TEXTURE_BLOCK_SIZE. Level 0 is the png.
+*/
+typedef struct {
+    texture_level_t levels[TEXTURE_MAX_LEVELS];
+    int num_levels;
+} texture_t;
+
 tex2_t tex2_clone(tex2_t* tex);
 
+texture_t* create_texture_from_png(upng_t* png_image);
+void free_texture(texture_t* texture);
+
+// Offset of the texel (x, y) in the blocks, the coordinates wrap around
+static inline int texture_offset(const texture_level_t* level, int x, int y) {
+    x &= level->width - 1;
+    y &= level->height - 1;
+    int block = ((y >> TEXTURE_BLOCK_BITS) << (level->width_shift - TEXTURE_BLOCK_BITS)) + (x >> TEXTURE_BLOCK_BITS);
+    int inside = ((y & (TEXTURE_BLOCK_SIZE - 1)) << TEXTURE_BLOCK_BITS) | (x & (TEXTURE_BLOCK_SIZE - 1));
+    return (block << (2 * TEXTURE_BLOCK_BITS)) | inside;
+}
+
+static inline uint32_t texture_fetch(const texture_level_t* level, int x, int y) {
+    return level->texels[texture_offset(level, x, y)];
+}
+
+// Nearest texel of the uv coordinates
+static inline uint32_t texture_sample_nearest(const texture_level_t* level, float u, float v) {
+    return texture_fetch(level, (int)(u * level->width), (int)(v * level->height));
+}
+
+/*
+* Blend of two texels, weight of b in [0, 256]
+* Two channels per 32 bits (16 bits each), integer only: the SIMD kernels do
+* the same operations in 16-bit lanes and find the exact same color.
+*/
+static inline uint32_t texture_lerp(uint32_t a, uint32_t b, uint32_t weight) {
+    uint32_t red_blue = ((a & 0x00FF00FF) * (256 - weight) + (b & 0x00FF00FF) * weight) >> 8;
+    uint32_t alpha_green = ((a >> 8) & 0x00FF00FF) * (256 - weight) + ((b >> 8) & 0x00FF00FF) * weight;
+    return (red_blue & 0x00FF00FF) | (alpha_green & 0xFF00FF00);
+}
+
+// Blend of the texels (x, y) to (x + 1, y + 1), weights in [0, 256)
+static inline uint32_t texture_fetch_bilinear(const texture_level_t* level, int x, int y, int weight_x, int weight_y) {
+    uint32_t top = texture_lerp(texture_fetch(level, x, y), texture_fetch(level, x + 1, y), weight_x);
+    uint32_t bottom = texture_lerp(texture_fetch(level, x, y + 1), texture_fetch(level, x + 1, y + 1), weight_x);
+    return texture_lerp(top, bottom, weight_y);
+}
+
+// Bilinear filtering of the uv coordinates, texel centers at half integers
+static inline uint32_t texture_sample_bilinear(const texture_level_t* level, float u, float v) {
+    float texel_u = u * level->width - 0.5f;
+    float texel_v = v * level->height - 0.5f;
+    float x = floorf(texel_u);
+    float y = floorf(texel_v);
+    return texture_fetch_bilinear(level, (int)x, (int)y, (int)((texel_u - x) * 256.0f), (int)((texel_v - y) * 256.0f));
+}
+
 #endif // !TEXTURE_H
@@ -0,0 +1,35 @@
+#ifndef TILE_H
+#define TILE_H
+
+#include "display.h"
+#include "triangle.h"
+
+/*
+* Sort-middle rasterization
+* -------------------------
+* The projected triangles are binned into screen tiles, then each worker
+* thread renders whole tiles. A pixel belongs to exactly one tile, so no lock
+* is needed and the triangles of a tile are drawn in submission order: the
+* output is the same as the single-threaded path, bit for bit.
+*
+* The frame is cleared tile by tile as well: a tile is cleared by its worker
+* right before its triangles (the lines stay in cache), a tile without any
+* triangle is filled with non-temporal stores. No full screen clear pass.
+*/
+#define TILE_SIZE 64  // Multiple of the 16 pixels affine spans of triangle.c
+
+typedef void (*tile_draw_fn)(triangle_t* triangle, const raster_settings_t* settings);
+
+/*
+* Bin and draw the triangles with all the available threads
+* @triangles: projected triangles, in submission order
+* @num_triangles: number of triangles
+* @margin: extra pixels drawn by @draw past the triangle bounding box
+* @draw: draw a triangle, only the pixels in the clip rect are written
+* @clear_color: background of the frame (see clear_rect())
+* @settings: raster settings of the frame, handed to @draw
+*/
+void render_tiles(triangle_t* triangles, int num_triangles, int margin, tile_draw_fn draw, color_t clear_color, const raster_settings_t* settings);
+void free_tiles(void);
+
+#endif // !TILE_H
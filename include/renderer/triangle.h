@@ -2,6 +2,7 @@
 #define TRIANGLE_H
 
 // for a face (triangle)
+#include "display.h"
 #include "texture.h"
 #include "vector.h"
 #include <stdint.h>
@@ -16,11 +17,12 @@ typedef struct {
     tex2_t tex_coords[3];
     uint32_t color;
     float light_intensity;
-    upng_t* texture;
+    texture_t* texture;
 } triangle_t;
 
-void draw_filled_triangle(triangle_t triangle, uint32_t color);
-void draw_textured_triangle(triangle_t triangle);
+// Raster settings of the frame, see raster_settings_t
+void draw_filled_triangle(triangle_t triangle, uint32_t color, const raster_settings_t* settings);
+void draw_textured_triangle(triangle_t triangle, const raster_settings_t* settings);
 vec3_t get_triangle_normal(vec4_t vertices[3]);
 
 #endif // !TRIANGLE_H
@@ -0,0 +1,23 @@
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include "triangle.h"
+
+/*
+* Visibility buffer (deferred texturing)
+* --------------------------------------
+* Pass one rasterizes only the depth and the index of the triangle of each
+* pixel. Pass two shades each visible pixel exactly once from the attribute
+* planes of its triangle: the shading cost is bounded by the resolution, not
+* by the overdraw of the scene.
+*/
+
+// Set up the attribute planes of the triangles of the frame (before pass one)
+void prepare_visibility_buffer(triangle_t* triangles, int num_triangles, const raster_settings_t* settings);
+// Pass one: depth and triangle index, only in the clip rect (tile callback)
+void draw_visibility_triangle(triangle_t* triangle, const raster_settings_t* settings);
+// Pass two: shade the pixels covered by a triangle
+void shade_visibility_buffer(const raster_settings_t* settings);
+void free_visibility_buffer(void);
+
+#endif // !VISIBILITY_H
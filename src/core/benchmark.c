@@ -0,0 +1,131 @@
+#include "benchmark.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+typedef struct {
+    double frame_time;  // ms
+    int num_triangles;
+    int num_pixels;
+    size_t frame_memory;  // Bytes taken from the frame arena
+    int num_allocations;  // Arena chunks allocated during the frame
+} benchmark_frame_t;
+
+static benchmark_frame_t* frames = NULL;
+static int num_recorded_frames = 0;
+static int max_frames = 0;
+static const char* scene_name;
+static int frame_width;
+static int frame_height;
+
+bool start_benchmark(const char* scene, int width, int height, int num_frames) {
+    free_benchmark();
+    frames = malloc(sizeof(benchmark_frame_t) * num_frames);
+    if (frames == NULL) {
+        fprintf(stderr, "[ERROR] Cannot allocate the benchmark of %d frames\n", num_frames);
+        return false;
+    }
+    max_frames = num_frames;
+    scene_name = scene;
+    frame_width = width;
+    frame_height = height;
+    return true;
+}
+
+void record_benchmark_frame(double frame_time, int num_triangles, int num_pixels, size_t frame_memory, int num_allocations) {
+    if (num_recorded_frames >= max_frames) {
+        return;
+    }
+    frames[num_recorded_frames++] = (benchmark_frame_t){ frame_time, num_triangles, num_pixels, frame_memory, num_allocations };
+}
+
+void free_benchmark(void) {
+    free(frames);
+    frames = NULL;
+    num_recorded_frames = 0;
+    max_frames = 0;
+}
+
+// Statistics -----------------------------------------------------------------
+
+static int compare_times(const void* a, const void* b) {
+    double time_a = *(const double*)a;
+    double time_b = *(const double*)b;
+    return (time_a > time_b) - (time_a < time_b);
+}
+
+// Nearest rank percentile of sorted times
+static double percentile(const double* sorted_times, int count, double p) {
+    int rank = (int)ceil(p * count);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return sorted_times[rank - 1];
+}
+
+bool write_benchmark_report(const char* path) {
+    int count = num_recorded_frames;
+    if (count == 0) {
+        fprintf(stderr, "[ERROR] No frame recorded by the benchmark\n");
+        return false;
+    }
+    FILE* file = path != NULL ? fopen(path, "w") : stdout;
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Cannot open %s\n", path);
+        return false;
+    }
+
+    double* sorted_times = malloc(sizeof(double) * count);
+    double total_time = 0.0;
+    size_t high_water_mark = 0;
+    int num_allocations = 0;
+    int last_allocation_frame = -1;
+    for (int i = 0; i < count; i++) {
+        sorted_times[i] = frames[i].frame_time;
+        total_time += frames[i].frame_time;
+        if (frames[i].frame_memory > high_water_mark) {
+            high_water_mark = frames[i].frame_memory;
+        }
+        if (frames[i].num_allocations > 0) {
+            num_allocations += frames[i].num_allocations;
+            last_allocation_frame = i;
+        }
+    }
+    qsort(sorted_times, count, sizeof(double), compare_times);
+    double median = count % 2 ? sorted_times[count / 2] : 0.5 * (sorted_times[count / 2 - 1] + sorted_times[count / 2]);
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"scene\": \"%s\",\n", scene_name);
+    fprintf(file, "    \"width\": %d,\n", frame_width);
+    fprintf(file, "    \"height\": %d,\n", frame_height);
+    fprintf(file, "    \"frames\": %d,\n", count);
+    fprintf(file, "    \"frame_time_ms\": {\n");
+    fprintf(file, "        \"mean\": %.4f,\n", total_time / count);
+    fprintf(file, "        \"median\": %.4f,\n", median);
+    fprintf(file, "        \"p95\": %.4f,\n", percentile(sorted_times, count, 0.95));
+    fprintf(file, "        \"p99\": %.4f,\n", percentile(sorted_times, count, 0.99));
+    fprintf(file, "        \"min\": %.4f,\n", sorted_times[0]);
+    fprintf(file, "        \"max\": %.4f\n", sorted_times[count - 1]);
+    fprintf(file, "    },\n");
+    fprintf(file, "    \"frame_memory\": {\n");
+    fprintf(file, "        \"high_water_mark_bytes\": %zu,\n", high_water_mark);
+    fprintf(file, "        \"chunk_allocations\": %d,\n", num_allocations);
+    fprintf(file, "        \"last_allocation_frame\": %d\n", last_allocation_frame);
+    fprintf(file, "    },\n");
+    fprintf(file, "    \"per_frame\": [\n");
+    for (int i = 0; i < count; i++) {
+        fprintf(
+            file, "        { \"time_ms\": %.4f, \"triangles\": %d, \"pixels\": %d, \"memory_bytes\": %zu }%s\n",
+            frames[i].frame_time, frames[i].num_triangles, frames[i].num_pixels, frames[i].frame_memory, i + 1 < count ? "," : ""
+        );
+    }
+    fprintf(file, "    ]\n");
+    fprintf(file, "}\n");
+    free(sorted_times);
+
+    bool is_written = !ferror(file);
+    if (file != stdout) {
+        is_written = fclose(file) == 0 && is_written;
+    }
+    return is_written;
+}
@@ -2,19 +2,30 @@
 #include <SDL2/SDL_stdinc.h>
 #include <SDL2/SDL_video.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <stdbool.h>
+#include "arena.h"
 #include "array.h"
 #include "camera.h"
 #include "clipping.h"
 #include "display.h"
 #include "light.h"
+#include "line.h"
 #include "matrix.h"
 #include "texture.h"
 #include "vector.h"
+#include "vertex_stream.h"
 #include "mesh.h"
 #include "triangle.h"
+#include "tile.h"
+#include "visibility.h"
 #include "entity.h"
+#include "geometry.h"
+#include "scene.h"
+#include "benchmark.h"
+#include "profiler.h"
 
 // Event Loop
 bool is_running = false;
@@ -22,20 +33,107 @@ int previous_frame_time = 0;
 float delta_time = 0;
 
 // Meshes
-#define MAX_TRIANGLES_PER_MESH 20000
-triangle_t triangle_to_render[MAX_TRIANGLES_PER_MESH];
+// Pipelined present: update() fills one frame arena while the raster thread draws from the other
+static frame_arena_t frame_arenas[2];
+triangle_t* triangle_to_render = NULL;  // In the frame arena, no limit on the count
 int num_triangles_to_render = 0;
 
-// Matrices
-mat4_t view_matrix;
-mat4_t world_matrix;
+/*
+* Geometry jobs: the faces of the meshes cut in chunks of FACES_PER_JOB, in
+* submission order. Each job is run by one worker into its own list, then the
+* lists are concatenated in job order: same triangles in the same order as a
+* single thread, without any lock.
+*
+* A list is a chain of blocks taken from the frame arena of the worker.
+*/
+#define FACES_PER_JOB 1024
+#define TRIANGLES_PER_BLOCK 256
+typedef struct triangle_block {
+    struct triangle_block* next;
+    int num_triangles;
+    triangle_t triangles[TRIANGLES_PER_BLOCK];
+} triangle_block_t;
+
+typedef struct {
+    mesh_t* mesh;
+    int first_face;
+    int num_faces;
+    triangle_block_t* first_block;
+    triangle_block_t* last_block;
+    int num_triangles;
+    int num_dropped_triangles;  // No block left in the frame arena for them
+    int offset;             // Index of its first triangle in triangle_to_render
+} geometry_job_t;
+static geometry_job_t* geometry_jobs = NULL;  // In the frame arena
+static int num_geometry_jobs = 0;
+
+// Everything draw_frame() reads: the settings can change while it runs on the raster thread
+typedef struct {
+    triangle_t* triangles;
+    int num_triangles;
+    int render_mode;
+    raster_settings_t settings;  // Depth format, SIMD, subpixel, mapping, mipmap and filter
+} frame_t;
+frame_t frames[2];
+int current_frame = 0;
+static int frame_render_mode;
 
 // Modes
 static color_t COLOR_CONTRAST = 0xFF1154BB;
+#define VERTEX_SIZE 4
 mat4_t perspective;
 
 #define PI 3.14159265
 
+// Command line
+typedef struct {
+    bool is_offscreen;
+    int width;
+    int height;
+    int num_frames;         // 0: until the window is closed
+    const char* dump_path;  // PPM of the last frame
+    const char* scene;
+    bool is_benchmark;      // Offscreen, uncapped, camera on the scene path
+    const char* report_path;// JSON of the benchmark, stdout when NULL
+    const char* profile_path;// CSV of the stage times of the last frames
+    int render_mode;        // -1: the default of setup()
+    int present_mode;       // -1: the default of the display
+} options_t;
+options_t options = { .width = 640, .height = 400, .scene = "planes", .render_mode = -1, .present_mode = -1 };
+
+// Names on the command line, in the order of the enums
+static const char* RENDER_MODE_NAMES[] = {
+    "wireframe", "wireframe_vertex", "triangle", "triangle_wireframe", "texture", "texture_wireframe", "visibility"
+};
+static const char* PRESENT_MODE_NAMES[] = { "lock", "update", "pipelined" };
+static const char* ON_OFF_NAMES[] = { "on", "off" };
+static const char* MAPPING_MODE_NAMES[] = { "perspective", "affine_span" };
+static const char* FILTER_MODE_NAMES[] = { "nearest", "bilinear" };
+static const char* DEPTH_FORMAT_NAMES[] = { "float", "unorm16", "unorm24", "reversed_float" };
+#define NUM_NAMES(names) ((int)(sizeof(names) / sizeof(names[0])))
+
+// Raster settings of the command line, the same as the keys of process_input()
+typedef struct {
+    const char* option;
+    const char** names;
+    int num_names;
+    void (*set_mode)(int mode);
+} raster_option_t;
+static const raster_option_t RASTER_OPTIONS[] = {
+    { "--simd", ON_OFF_NAMES, NUM_NAMES(ON_OFF_NAMES), set_simd_mode },
+    { "--subpixel", ON_OFF_NAMES, NUM_NAMES(ON_OFF_NAMES), set_subpixel_mode },
+    { "--mapping", MAPPING_MODE_NAMES, NUM_NAMES(MAPPING_MODE_NAMES), set_mapping_mode },
+    { "--mipmap", ON_OFF_NAMES, NUM_NAMES(ON_OFF_NAMES), set_mipmap_mode },
+    { "--filter", FILTER_MODE_NAMES, NUM_NAMES(FILTER_MODE_NAMES), set_filter_mode },
+    { "--depth", DEPTH_FORMAT_NAMES, NUM_NAMES(DEPTH_FORMAT_NAMES), set_depth_format },
+};
+#define NUM_RASTER_OPTIONS NUM_NAMES(RASTER_OPTIONS)
+static int raster_option_modes[NUM_RASTER_OPTIONS] = { -1, -1, -1, -1, -1, -1 };  // -1: the default of the display
+
+#define CLEAR_COLOR 0xFF000000
+#define BENCHMARK_FRAMES 300
+#define BENCHMARK_DELTA_TIME (1.0 / FPS)
+
 // Control
 float previous_mouse_x = 0.0;
 float previous_mouse_y = 0.0;
@@ -60,20 +158,39 @@ void setup(void) {
     float near = 0.1;
     float far = 100.0;
     perspective = mat4_make_perspective(fovy, aspecty, near, far);
+    set_depth_range(near, far);
 
     initialize_frustum_planes(fovy, fovx, near, far);
 
-    // Entities
-    load_entity("./assets/planes/f22", (vec3_t){1, 1, 1}, (vec3_t){0, -1.3, +5}, (vec3_t){0, -PI/2, 0});
-    load_entity("./assets/planes/f117", (vec3_t){1, 1, 1}, (vec3_t){2, -1.3, +9}, (vec3_t){0, -PI/2, 0});
-    load_entity("./assets/planes/efa", (vec3_t){1, 1, 1}, (vec3_t){-2, -1.3, +9}, (vec3_t){0, -PI/2, 0});
+    // Command line overrides
+    if (options.render_mode >= 0) {
+        set_render_mode(options.render_mode);
+    }
+    if (options.present_mode >= 0) {
+        set_present_mode(options.present_mode);
+    }
+    for (int i = 0; i < NUM_RASTER_OPTIONS; i++) {
+        if (raster_option_modes[i] >= 0) {
+            RASTER_OPTIONS[i].set_mode(raster_option_modes[i]);
+        }
+    }
 
-    // Props
-    load_prop("./assets/planes/runway", (vec3_t){1, 0, 1}, (vec3_t){0, -1.5, +23}, (vec3_t){0, 0, 0});
+    PROFILE_INITIALIZE();
+    initialize_frame_arena(&frame_arenas[0]);
+    initialize_frame_arena(&frame_arenas[1]);
 
+    // Entities and props
+    if (!load_scene(options.scene)) {
+        is_running = false;
+    }
 }
 
 void free_ressources(void) {
+    free_tiles();
+    free_frame_arena(&frame_arenas[0]);
+    free_frame_arena(&frame_arenas[1]);
+    free_visibility_buffer();
+    free_wireframe();
     free_meshes();
 }
 
@@ -122,6 +239,50 @@ void process_input(void) {
                     set_render_mode(TEXTURE_AND_WIREFRAME);
                     break;
                 }
+                if (event.key.keysym.sym == SDLK_b) {
+                    set_render_mode(VISIBILITY_BUFFER);
+                    break;
+                }
+                // Raster kernel (AVX2 or scalar) -
+                if (event.key.keysym.sym == SDLK_v) {
+                    set_simd_mode((get_simd_mode() + 1) % 2);
+                    break;
+                }
+                // Subpixel precision (28.4 or whole pixel)
+                if (event.key.keysym.sym == SDLK_p) {
+                    set_subpixel_mode((get_subpixel_mode() + 1) % 2);
+                    break;
+                }
+                // Texture mapping (perspective or affine spans)
+                if (event.key.keysym.sym == SDLK_m) {
+                    set_mapping_mode((get_mapping_mode() + 1) % 2);
+                    break;
+                }
+                // Mipmaps (per triangle level or full resolution)
+                if (event.key.keysym.sym == SDLK_n) {
+                    set_mipmap_mode((get_mipmap_mode() + 1) % 2);
+                    break;
+                }
+                // Texture filtering (nearest or bilinear)
+                if (event.key.keysym.sym == SDLK_f) {
+                    set_filter_mode((get_filter_mode() + 1) % 2);
+                    break;
+                }
+                // Depth format (float, 16 bits, 24 bits, reversed float)
+                if (event.key.keysym.sym == SDLK_z) {
+                    set_depth_format((get_depth_format() + 1) % 4);
+                    break;
+                }
+                // Present (locked texture, copied color buffer or pipelined)
+                if (event.key.keysym.sym == SDLK_x) {
+                    set_present_mode((get_present_mode() + 1) % 3);
+                    break;
+                }
+                // Rolling summary of the stage times
+                if (event.key.keysym.sym == SDLK_k) {
+                    set_profile_summary(!get_profile_summary());
+                    break;
+                }
                 // Light mode ---------------------
                 if (event.key.keysym.sym == SDLK_l) {
                     set_current_light_mode((get_current_light_mode() + 1) % 2);
@@ -178,6 +339,44 @@ void process_input(void) {
 // Update Function =============================================================
 
 
+// Save the projected tri. in the list of the job, a new block from the arena when the last one is full
+static void emit_triangle(geometry_job_t* job, arena_t* arena, const mesh_t* mesh, const face_t* face, vec3_t normal, const vec4_t points[3], const tex2_t tex_coords[3]) {
+    PROFILE_BEGIN(STAGE_EMISSION);
+    float light_factor = 1.0;
+    if (get_current_light_mode() == LIGHT_ON) {
+        light_factor = -vec3_dot_product(normal, get_light().direction);
+    }
+
+    triangle_t projected_triangle = {
+        .color = face->color,
+        .light_intensity = light_factor,
+        .points = { points[0], points[1], points[2] },
+        .tex_coords = { tex_coords[0], tex_coords[1], tex_coords[2] },
+        .texture = mesh->texture
+    };
+    triangle_block_t* block = job->last_block;
+    if (block == NULL || block->num_triangles == TRIANGLES_PER_BLOCK) {
+        block = arena_alloc(arena, sizeof(triangle_block_t));
+        if (block == NULL) {
+            job->num_dropped_triangles++;  // Reported by update(), once per frame
+            PROFILE_END(STAGE_EMISSION);
+            return;
+        }
+        block->next = NULL;
+        block->num_triangles = 0;
+        if (job->last_block != NULL) {
+            job->last_block->next = block;
+        } else {
+            job->first_block = block;
+        }
+        job->last_block = block;
+    }
+    block->triangles[block->num_triangles++] = projected_triangle;
+    job->num_triangles++;
+    PROFILE_END(STAGE_EMISSION);
+}
+
+
 /* 
 * Graphic Pipeline
 * ----------------
@@ -189,79 +388,98 @@ void process_input(void) {
 *              |_ Image Space (with perspective divide)
 *                 |_ Screen Space
 */
-void process_graphic_pipeline(mesh_t* mesh) {
+void process_vertex_stage(mesh_t* mesh, mat4_t view_matrix, int view_version) {
     // MOVEMENT OF CAMERA -----------------------------------------------------
-    vec3_t target = get_camera_lookat_target();
-    view_matrix = mat4_look_at(get_camera_position(), target);
-    
     // MODEL SPACE -> WORLD SPACE ---------------------------------------------
-    // Transformation matrices
-    mat4_t scale_matrix = mat4_make_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
-    mat4_t translation_matrix = mat4_make_translation(mesh->translation.x, mesh->translation.y, mesh->translation.z);
-    mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh->rotation.x);
-    mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh->rotation.y);
-    mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh->rotation.z);
-    // World matrix
-    world_matrix = mat4_identity();
-    world_matrix = mat4_mult(world_matrix, translation_matrix);
-    world_matrix = mat4_mult(world_matrix, rotation_matrix_x);
-    world_matrix = mat4_mult(world_matrix, rotation_matrix_y);
-    world_matrix = mat4_mult(world_matrix, rotation_matrix_z);
-    world_matrix = mat4_mult(world_matrix, scale_matrix);   //
-
-    for (int i = 0; i < array_length(mesh->faces); i++) {
-        face_t mesh_face = mesh->faces[i];
-        vec3_t face_vertices[3];
-        face_vertices[0] = mesh->vertices[mesh_face.a];
-        face_vertices[1] = mesh->vertices[mesh_face.b];
-        face_vertices[2] = mesh->vertices[mesh_face.c];
-
-        vec4_t transformed_vertices[3];
-
-        // Loop over the vertices and apply the transformation and save it for the renderer
-        for (int j = 0; j < 3; j++) {
-            vec4_t transformed_vertex = vec4_from_vec3(face_vertices[j]);
-            transformed_vertex = mat4_mult_vec4(world_matrix, transformed_vertex);
-            // WORLD SPACE -> CAMERA SPACE -------------------------------------
-            transformed_vertex = mat4_mult_vec4(view_matrix, transformed_vertex);
-            transformed_vertices[j] = transformed_vertex;
+    // The matrices are cached: only rebuilt when the camera or the mesh moved
+    PROFILE_BEGIN(STAGE_MATRICES);
+    bool is_model_view_changed = update_mesh_matrices(mesh, view_matrix, view_version);
+    PROFILE_END(STAGE_MATRICES);
+
+    // Per vertex and per face passes over the SoA streams, 8 at a time
+    // Each vertex once, shared by all its faces, and kept while nothing moves
+    if (is_model_view_changed) {
+        // WORLD SPACE -> CAMERA SPACE ----------------------------------------
+        PROFILE_BEGIN(STAGE_VERTEX_TRANSFORM);
+        transform_vertex_stream(&mesh->model_view_matrix, &mesh->vertices, &mesh->camera_vertices);
+        PROFILE_END(STAGE_VERTEX_TRANSFORM);
+
+        // CULLING ------------------------------------------------------------
+        PROFILE_BEGIN(STAGE_CULLING);
+        compute_face_normals(mesh->faces, array_length(mesh->faces), &mesh->camera_vertices, &mesh->face_normals, mesh->is_front_face);
+        PROFILE_END(STAGE_CULLING);
+
+        // PROJECTION ---------------------------------------------------------
+        // Screen position and frustum planes of each vertex
+        PROFILE_BEGIN(STAGE_PROJECTION);
+        project_vertex_stream(
+            &perspective, &mesh->camera_vertices, &mesh->screen_vertices,
+            mesh->clip_flags, get_window_width(), get_window_height()
+        );
+        PROFILE_END(STAGE_PROJECTION);
+    }
+}
+
+// Clipping, projection and emission of the faces of a job
+void process_faces(geometry_job_t* job) {
+    const mesh_t* mesh = job->mesh;
+    // The whole job runs on one thread
+    arena_t* arena = get_thread_arena(&frame_arenas[current_frame]);
+    const vertex_stream_t* screen = &mesh->screen_vertices;
+    for (int i = job->first_face; i < job->first_face + job->num_faces; i++) {
+        const face_t* mesh_face = &mesh->faces[i];
+
+        // Prune the negative triangle
+        if (get_culling_mode() == CULLING_ON && !mesh->is_front_face[i]) {
+            continue;
+        }
+        vec3_t normal = get_vertex_stream_vec3(&mesh->face_normals, i);
+
+        // Outside of the same plane: nothing left after clipping
+        clip_flags_t flags_a = mesh->clip_flags[mesh_face->a];
+        clip_flags_t flags_b = mesh->clip_flags[mesh_face->b];
+        clip_flags_t flags_c = mesh->clip_flags[mesh_face->c];
+        if ((flags_a & flags_b & flags_c) != 0) {
+            continue;
         }
 
-        // CULLING -----------------------------------------------------------
-        // Find the normal
-        vec3_t normal = get_triangle_normal(transformed_vertices);
-        // Vector between the a point in the triangle and the origin
-        vec3_t camera_ray = vec3_sub((vec3_t){0, 0, 0}, vec3_from_vec4(transformed_vertices[0]));
-        // Verify if the normal and camera are align
-        float alignment_with_camera = vec3_dot_product(camera_ray, normal);
-        if (get_culling_mode() == CULLING_ON) {
-            // Prune the negative triangle
-            if (alignment_with_camera < 0) {
-                continue;
+        // Inside all the planes: clipping gives back the triangle, already projected
+        if ((flags_a | flags_b | flags_c) == 0) {
+            int indices[3] = { mesh_face->a, mesh_face->b, mesh_face->c };
+            vec4_t projected_points[3];
+            for (int j = 0; j < 3; j++) {
+                int v = indices[j];
+                projected_points[j] = (vec4_t){ { screen->x[v], screen->y[v], screen->z[v], screen->w[v] } };
             }
+            tex2_t tex_coords[3] = { mesh_face->a_uv, mesh_face->b_uv, mesh_face->c_uv };
+            emit_triangle(job, arena, mesh, mesh_face, normal, projected_points, tex_coords);
+            continue;
         }
 
         // CLIPPING -----------------------------------------------------------
+        PROFILE_BEGIN(STAGE_CLIPPING);
         // Create a polygon from the triangle
         polygon_t polygon = create_polygon_from_triangle(
-            vec3_from_vec4(transformed_vertices[0]),
-            vec3_from_vec4(transformed_vertices[1]),
-            vec3_from_vec4(transformed_vertices[2]),
-            mesh_face.a_uv,
-            mesh_face.b_uv,
-            mesh_face.c_uv
+            get_vertex_stream_vec3(&mesh->camera_vertices, mesh_face->a),
+            get_vertex_stream_vec3(&mesh->camera_vertices, mesh_face->b),
+            get_vertex_stream_vec3(&mesh->camera_vertices, mesh_face->c),
+            mesh_face->a_uv,
+            mesh_face->b_uv,
+            mesh_face->c_uv
         );
         clip_polygon(&polygon);
         // Create a triangle from the polygon
         triangle_t clipped_triangles[MAX_NUM_TRIANGLES];
         int num_clipped_triangles = 0;
         create_triangles_from_polygon(&polygon, clipped_triangles, &num_clipped_triangles, mesh->texture);
+        PROFILE_END(STAGE_CLIPPING);
 
         // Only render the triangle that are inside the frustum
         for (int t = 0; t < num_clipped_triangles; t++) {
             triangle_t clipped_triangle = clipped_triangles[t];
 
             // PROJECTION -----------------------------------------------------
+            PROFILE_BEGIN(STAGE_PROJECTION);
             vec4_t projected_points[3];
             // Project the point in 2D
             for (int j = 0; j < 3; j++) {
@@ -281,30 +499,9 @@ void process_graphic_pipeline(mesh_t* mesh) {
                 projected_points[j].data[0] += (float)get_window_width() / 2;
                 projected_points[j].data[1] += (float)get_window_height() / 2;
             }
+            PROFILE_END(STAGE_PROJECTION);
 
-            float light_factor = 1.0;
-            if (get_current_light_mode() == LIGHT_ON) {
-                light_factor = -vec3_dot_product(normal, get_light().direction);
-            }
-            
-            triangle_t projected_triangle = {
-                .color = mesh_face.color,
-                .light_intensity = light_factor,
-                .points = {
-                    projected_points[0],
-                    projected_points[1],
-                    projected_points[2]
-                },
-                .tex_coords = {
-                    { clipped_triangle.tex_coords[0].u, clipped_triangle.tex_coords[0].v },
-                    { clipped_triangle.tex_coords[1].u, clipped_triangle.tex_coords[1].v },
-                    { clipped_triangle.tex_coords[2].u, clipped_triangle.tex_coords[2].v },
-                },
-                .texture = mesh->texture
-            };
-
-            // Save the projected tri. for the renderer
-            triangle_to_render[num_triangles_to_render++] = projected_triangle;
+            emit_triangle(job, arena, mesh, mesh_face, normal, projected_points, clipped_triangle.tex_coords);
         }
     }
 }
@@ -314,39 +511,164 @@ void process_graphic_pipeline(mesh_t* mesh) {
 * Update Each "Objects" and pass them to the graphic pipeline
 */
 void update(void) {
-    // Limit the tick to the FRAME_TARGET_TIME
-    int time_to_wait = FRAME_TARGET_TIME - (SDL_GetTicks() - previous_frame_time);
-    while (!SDL_TICKS_PASSED(
-        SDL_GetTicks(),
-        previous_frame_time + FRAME_TARGET_TIME))
-    {
-        SDL_Delay(time_to_wait);
-    }
-    delta_time = (SDL_GetTicks() - previous_frame_time) / 1000.0; // For update game object
-    previous_frame_time = SDL_GetTicks();
-
-    // Init or render array
+    if (options.is_benchmark) {
+        // Same work on every run: no frame cap and a fixed time step
+        delta_time = BENCHMARK_DELTA_TIME;
+    } else {
+        // Limit the tick to the FRAME_TARGET_TIME
+        int time_to_wait = FRAME_TARGET_TIME - (SDL_GetTicks() - previous_frame_time);
+        while (!SDL_TICKS_PASSED(
+            SDL_GetTicks(),
+            previous_frame_time + FRAME_TARGET_TIME))
+        {
+            SDL_Delay(time_to_wait);
+        }
+        delta_time = (SDL_GetTicks() - previous_frame_time) / 1000.0; // For update game object
+        previous_frame_time = SDL_GetTicks();
+    }
+
+    // Everything of the previous use of this arena has been drawn
+    frame_arena_t* frame_arena = &frame_arenas[current_frame];
+    reset_frame_arena(frame_arena);
+    arena_t* main_arena = get_thread_arena(frame_arena);
     num_triangles_to_render = 0;
 
-    for (int mesh_idx = 0; mesh_idx < get_num_meshes(); mesh_idx++) { 
+    // Vertex stage: the meshes are independent
+    // The camera rebuilds its view matrix lazily: read it once, before the workers
+    mat4_t view_matrix = get_camera_view_matrix();
+    int view_version = get_camera_view_version();
+    int num_meshes = get_num_meshes();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int mesh_idx = 0; mesh_idx < num_meshes; mesh_idx++) {
+        mesh_t* mesh = get_mesh(mesh_idx);
+
+        // MOVEMENT OF OBJECT -------------------------------------------------
+        // Through the setters, to rebuild the cached matrices
+        // set_mesh_rotation(mesh, vec3_add(mesh->rotation, (vec3_t){0.4 * delta_time, 0.2 * delta_time, 0.1 * delta_time}));
+        // set_mesh_scale(mesh, vec3_add(mesh->scale, (vec3_t){0.02 * delta_time, 0.01 * delta_time, 0}));
+        // set_mesh_translation(mesh, (vec3_t){mesh->translation.x, mesh->translation.y, 5.0});
+
+        process_vertex_stage(mesh, view_matrix, view_version);
+    }
 
+    // Face stage: jobs of all the meshes, each with its own output list
+    num_geometry_jobs = 0;
+    for (int mesh_idx = 0; mesh_idx < num_meshes; mesh_idx++) {
+        num_geometry_jobs += (array_length(get_mesh(mesh_idx)->faces) + FACES_PER_JOB - 1) / FACES_PER_JOB;
+    }
+    geometry_jobs = arena_alloc(main_arena, sizeof(geometry_job_t) * num_geometry_jobs);
+    if (geometry_jobs == NULL) {
+        fprintf(stderr, "[ERROR] Cannot allocate the %d geometry jobs, nothing is drawn this frame\n", num_geometry_jobs);
+        num_geometry_jobs = 0;
+    }
+    int next_job = 0;
+    for (int mesh_idx = 0; mesh_idx < num_meshes && geometry_jobs != NULL; mesh_idx++) {
         mesh_t* mesh = get_mesh(mesh_idx);
-        if (mesh == NULL) {
-            printf("[ERROR] Mesh %d is NULL\n", mesh_idx);
-            continue;
+        int num_faces = array_length(mesh->faces);
+        for (int first_face = 0; first_face < num_faces; first_face += FACES_PER_JOB) {
+            geometry_jobs[next_job++] = (geometry_job_t){
+                .mesh = mesh,
+                .first_face = first_face,
+                .num_faces = num_faces - first_face < FACES_PER_JOB ? num_faces - first_face : FACES_PER_JOB
+            };
         }
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int job = 0; job < num_geometry_jobs; job++) {
+        process_faces(&geometry_jobs[job]);
+    }
 
-        // MOVEMENT OF OBJECT -------------------------------------------------
-        // mesh->rotation.x += 0.4 * delta_time;
-        // mesh->rotation.y += 0.2 * delta_time;
-        // mesh->rotation.z += 0.1 * delta_time;
-        // mesh->scale.x += 0.02 * delta_time;
-        // mesh->scale.y += 0.01 * delta_time;
-        // mesh->translation.z += 0.01 * delta_time;
-        // mesh->translation.z = 5.0;
+    // Concatenate the lists in submission order
+    PROFILE_BEGIN(STAGE_EMISSION);
+    int num_dropped_triangles = 0;
+    for (int job = 0; job < num_geometry_jobs; job++) {
+        geometry_jobs[job].offset = num_triangles_to_render;
+        num_triangles_to_render += geometry_jobs[job].num_triangles;
+        num_dropped_triangles += geometry_jobs[job].num_dropped_triangles;
+    }
+    if (num_dropped_triangles > 0) {
+        fprintf(stderr, "[ERROR] Out of frame memory, %d triangles are not drawn this frame\n", num_dropped_triangles);
+    }
+    triangle_to_render = arena_alloc(main_arena, sizeof(triangle_t) * num_triangles_to_render);
+    if (triangle_to_render == NULL) {
+        fprintf(stderr, "[ERROR] Cannot allocate the %d triangles to render, nothing is drawn this frame\n", num_triangles_to_render);
+        num_triangles_to_render = 0;
+    }
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int job = 0; job < num_geometry_jobs; job++) {
+        triangle_t* triangles = &triangle_to_render[geometry_jobs[job].offset];
+        for (triangle_block_t* block = geometry_jobs[job].first_block; block != NULL && triangle_to_render != NULL; block = block->next) {
+            memcpy(triangles, block->triangles, sizeof(triangle_t) * block->num_triangles);
+            triangles += block->num_triangles;
+        }
+    }
+    PROFILE_END(STAGE_EMISSION);
+}
 
-        process_graphic_pipeline(mesh);
+// Arena chunks allocated so far, by both frame arenas
+int get_frame_memory_allocations(void) {
+    return get_frame_arena_stats(&frame_arenas[0]).num_chunk_allocations
+        + get_frame_arena_stats(&frame_arenas[1]).num_chunk_allocations;
+}
+
+/*
+* Draw a triangle according to the rendering mode
+* Called by the tile workers: only the pixels of the current tile are written
+*/
+void draw_triangle_with_render_mode(triangle_t* triangle, const raster_settings_t* settings) {
+    switch (frame_render_mode) {
+        case WIREFRAME_AND_VERTEX:
+            draw_wireframe_triangle(triangle, triangle->color);
+            for (int j = 0; j < 3; j++) {
+                draw_rec(triangle->points[j].data[0], triangle->points[j].data[1], VERTEX_SIZE, VERTEX_SIZE, COLOR_CONTRAST);
+            }
+            break;
+        case WIREFRAME:
+            draw_wireframe_triangle(triangle, triangle->color);
+            break;
+        case TRIANGLE:
+            draw_filled_triangle(*triangle, triangle->color, settings);
+            break;
+        case TRIANGLE_AND_WIREFRAME:
+            draw_triangle(*triangle, COLOR_CONTRAST);
+            draw_filled_triangle(*triangle, triangle->color, settings);
+            break;
+        case TEXTURE:
+            draw_textured_triangle(*triangle, settings);
+            break;
+        case TEXTURE_AND_WIREFRAME:
+            draw_triangle(*triangle, COLOR_CONTRAST);
+            draw_textured_triangle(*triangle, settings);
+            break;
+        case VISIBILITY_BUFFER:
+            draw_visibility_triangle(triangle, settings);
+            break;
+    }
+}
 
+/*
+* Draw a frame in the color buffer
+* On the raster thread when the present is pipelined
+*/
+void draw_frame(void* data) {
+    frame_t* frame = data;
+    frame_render_mode = frame->render_mode;
+
+    // Clear and render all the triangle that need to be renderer, tile by tile on all the cores
+    PROFILE_BEGIN(STAGE_BINNING);
+    if (frame->render_mode == VISIBILITY_BUFFER) {
+        prepare_visibility_buffer(frame->triangles, frame->num_triangles, &frame->settings);
+    }
+    if (frame->render_mode == WIREFRAME || frame->render_mode == WIREFRAME_AND_VERTEX) {
+        // The edges are interleaved with the fills in the other modes: keep them per triangle
+        prepare_wireframe(frame->triangles, frame->num_triangles);
+    }
+    PROFILE_END(STAGE_BINNING);
+    render_tiles(frame->triangles, frame->num_triangles, VERTEX_SIZE, draw_triangle_with_render_mode, CLEAR_COLOR, &frame->settings);
+    if (frame->render_mode == VISIBILITY_BUFFER) {
+        PROFILE_BEGIN(STAGE_SHADING);
+        shade_visibility_buffer(&frame->settings);
+        PROFILE_END(STAGE_SHADING);
     }
 }
 
@@ -354,63 +676,202 @@ void update(void) {
 * Render the triangle to the screen
 */
 void render(void) {
-    // Clear buffer
-    clear_color_buffer(0xFF000000);
-    clear_z_buffer();
-    draw_ref();
-
-    // Render all the triangle that need to be renderer
-    for (int i = 0; i < num_triangles_to_render; i++) {
-        switch (get_render_mode()) {
-            case WIREFRAME_AND_VERTEX:
-                draw_triangle(triangle_to_render[i], triangle_to_render[i].color);
-                for (int j = 0; j < 3; j++) {
-                    draw_rec(triangle_to_render[i].points[j].data[0], triangle_to_render[i].points[j].data[1], 4, 4, COLOR_CONTRAST);
-                }
-                break;
-            case WIREFRAME:
-                draw_triangle(triangle_to_render[i], triangle_to_render[i].color);
-                break;
-            case TRIANGLE:
-                draw_filled_triangle(triangle_to_render[i], triangle_to_render[i].color);
-                break;
-            case TRIANGLE_AND_WIREFRAME:
-                draw_triangle(triangle_to_render[i], COLOR_CONTRAST);
-                draw_filled_triangle(triangle_to_render[i], triangle_to_render[i].color);
-                break;
-            case TEXTURE:
-                draw_textured_triangle(triangle_to_render[i]);
-                break;
-            case TEXTURE_AND_WIREFRAME:
-                draw_triangle(triangle_to_render[i], COLOR_CONTRAST);
-                draw_textured_triangle(triangle_to_render[i]);
-                break;
-            break;
+    frames[current_frame] = (frame_t){
+        .triangles = triangle_to_render,
+        .num_triangles = num_triangles_to_render,
+        .render_mode = get_render_mode(),
+        .settings = get_raster_settings()
+    };
+    render_frame(draw_frame, &frames[current_frame]);
+
+    // The next frame is transformed in the other arena
+    current_frame = 1 - current_frame;
+}
+
+// Main Function ===============================================================
+
+void print_usage(const char* program) {
+    printf(
+        "Usage: %s [options]\n"
+        "  --offscreen WIDTHxHEIGHT  Render without a window (default size 640x400)\n"
+        "  --frames N                Quit after N frames\n"
+        "  --dump FILE.ppm           Save the last frame\n"
+        "  --scene NAME              planes (default), cube, sphere or teapot\n"
+        "  --benchmark               Offscreen and uncapped, the camera orbits the scene (%d frames by default)\n"
+        "  --report FILE.json        Frame statistics of the benchmark (default stdout)\n"
+        "  --profile FILE.csv        Stage times of the last frames (profiler builds only)\n"
+        "  --render-mode NAME        wireframe, wireframe_vertex, triangle, triangle_wireframe,\n"
+        "                            texture, texture_wireframe or visibility\n"
+        "  --present NAME            lock, update or pipelined\n"
+        "  --simd on|off             AVX2 raster and geometry kernels\n"
+        "  --subpixel on|off         Sub-pixel precision of the rasterizer\n"
+        "  --mapping NAME            perspective or affine_span texture mapping\n"
+        "  --mipmap on|off           Mipmapped textures\n"
+        "  --filter NAME             nearest or bilinear texture filtering\n"
+        "  --depth NAME              float, unorm16, unorm24 or reversed_float depth buffer\n",
+        program,
+        BENCHMARK_FRAMES
+    );
+}
+
+// Index of the name, -1 if unknown
+int find_name(const char* names[], int num_names, const char* name) {
+    for (int i = 0; i < num_names; i++) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
         }
     }
+    fprintf(stderr, "[ERROR] Unknown name: %s\n", name);
+    return -1;
+}
 
-    // Render
-    render_color_buffer();
+// Index in RASTER_OPTIONS, -1 if not a raster setting
+int find_raster_option(const char* option) {
+    for (int i = 0; i < NUM_RASTER_OPTIONS; i++) {
+        if (strcmp(RASTER_OPTIONS[i].option, option) == 0) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-// Main Function ===============================================================
+bool parse_options(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        int raster_option = find_raster_option(argv[i]);
+        if (strcmp(argv[i], "--offscreen") == 0) {
+            options.is_offscreen = true;
+            if (value != NULL && sscanf(value, "%dx%d", &options.width, &options.height) == 2) {
+                i++;
+            }
+            if (options.width <= 0 || options.height <= 0) {
+                fprintf(stderr, "[ERROR] Invalid offscreen size %dx%d\n", options.width, options.height);
+                return false;
+            }
+        } else if (strcmp(argv[i], "--frames") == 0 && value != NULL) {
+            options.num_frames = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--dump") == 0 && value != NULL) {
+            options.dump_path = value;
+            i++;
+        } else if (strcmp(argv[i], "--scene") == 0 && value != NULL) {
+            options.scene = value;
+            i++;
+        } else if (strcmp(argv[i], "--benchmark") == 0) {
+            options.is_benchmark = true;
+            options.is_offscreen = true;
+        } else if (strcmp(argv[i], "--report") == 0 && value != NULL) {
+            options.report_path = value;
+            i++;
+        } else if (strcmp(argv[i], "--profile") == 0 && value != NULL) {
+            options.profile_path = value;
+            i++;
+        } else if (strcmp(argv[i], "--render-mode") == 0 && value != NULL) {
+            options.render_mode = find_name(RENDER_MODE_NAMES, NUM_NAMES(RENDER_MODE_NAMES), value);
+            if (options.render_mode < 0) {
+                return false;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--present") == 0 && value != NULL) {
+            options.present_mode = find_name(PRESENT_MODE_NAMES, NUM_NAMES(PRESENT_MODE_NAMES), value);
+            if (options.present_mode < 0) {
+                return false;
+            }
+            i++;
+        } else if (raster_option >= 0 && value != NULL) {
+            const raster_option_t* option = &RASTER_OPTIONS[raster_option];
+            raster_option_modes[raster_option] = find_name(option->names, option->num_names, value);
+            if (raster_option_modes[raster_option] < 0) {
+                return false;
+            }
+            i++;
+        } else {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.is_benchmark && options.num_frames <= 0) {
+        options.num_frames = BENCHMARK_FRAMES;
+    }
+    if (options.is_offscreen && options.num_frames <= 0) {
+        options.num_frames = 1;  // Nothing can close the window
+    }
+    return true;
+}
 
 int main(int argc, char *argv[]) {
 
-    // Create SDL window
-    is_running = initialize_window(true, false);
+    if (!parse_options(argc, argv)) {
+        return 1;
+    }
+
+    // Create SDL window, or only the buffers
+    if (options.is_offscreen) {
+        is_running = initialize_offscreen(options.width, options.height);
+    } else {
+        is_running = initialize_window(true, false);
+    }
 
     setup();
+    if (is_running && options.is_benchmark) {
+        is_running = start_benchmark(options.scene, get_window_width(), get_window_height(), options.num_frames);
+    }
+    if (!is_running) {
+        destroy_window();
+        free_ressources();
+        return 1;
+    }
 
-    while (is_running) {
-        process_input();
-        update();
-        render();
+    for (int frame = 0; is_running; frame++) {
+        if (!options.is_offscreen) {
+            process_input();
+        }
+        if (!options.is_benchmark) {
+            update();
+            render();
+            PROFILE_FRAME_END();
+        } else {
+            // The camera is moved before the timer: only the frame itself is measured
+            update_scene_camera((float)frame / options.num_frames);
+            int num_allocations = get_frame_memory_allocations();
+            Uint64 start = SDL_GetPerformanceCounter();
+            update();
+            int num_triangles = num_triangles_to_render;
+            size_t frame_memory = get_frame_arena_stats(&frame_arenas[current_frame]).used;
+            render();
+            finish_frame();
+            double frame_time = 1000.0 * (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency();
+            num_allocations = get_frame_memory_allocations() - num_allocations;
+            record_benchmark_frame(frame_time, num_triangles, count_drawn_pixels(CLEAR_COLOR), frame_memory, num_allocations);
+            PROFILE_FRAME_END();
+        }
+        if (options.num_frames > 0 && frame + 1 >= options.num_frames) {
+            is_running = false;
+        }
+    }
+
+    int exit_code = 0;
+    finish_frame();
+    if (options.dump_path != NULL && !save_frame_ppm(options.dump_path)) {
+        exit_code = 1;
+    }
+    if (options.is_benchmark && !write_benchmark_report(options.report_path)) {
+        exit_code = 1;
+    }
+    if (options.profile_path != NULL) {
+#ifdef PROFILER_ON
+        if (!save_profile_csv(options.profile_path)) {
+            exit_code = 1;
+        }
+#else
+        fprintf(stderr, "[WARNING] The profiler is compiled out of the release build (build with profile=1)\n");
+#endif
     }
+    free_benchmark();
 
     destroy_window();
     free_ressources();
 
-    return 0;
+    return exit_code;
 }
 
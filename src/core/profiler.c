@@ -0,0 +1,126 @@
+#include "profiler.h"
+#include <SDL2/SDL.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+static const char* stage_names[NUM_STAGES] = {
+    "matrices",
+    "vertex_transform",
+    "culling",
+    "clipping",
+    "projection",
+    "emission",
+    "binning",
+    "clear",
+    "raster",
+    "shading",
+    "present"
+};
+
+// Ticks of the current frame, added from any thread
+static _Atomic uint64_t stage_ticks[NUM_STAGES];
+
+// Ring buffer of the last frames, in ms
+static float history[PROFILER_HISTORY][NUM_STAGES];
+static int num_frames = 0;
+static bool is_summary_printed = false;
+
+#ifdef PROFILER_ON
+// Calibration of the ticks against the SDL counter, since profiler_initialize()
+static bool is_calibrated = false;
+static uint64_t first_ticks;
+static uint64_t first_counter;
+#endif
+
+void profiler_add(profile_stage_t stage, uint64_t ticks) {
+    atomic_fetch_add_explicit(&stage_ticks[stage], ticks, memory_order_relaxed);
+}
+
+void profiler_initialize(void) {
+#ifdef PROFILER_ON
+    first_ticks = profiler_ticks();
+    first_counter = SDL_GetPerformanceCounter();
+    is_calibrated = true;
+    // Long enough to measure the first frame, before the frame loop starts
+    SDL_Delay(10);
+#endif
+}
+
+static double get_ticks_per_ms(void) {
+#ifdef PROFILER_ON
+    uint64_t ticks = profiler_ticks();
+    uint64_t counter = SDL_GetPerformanceCounter();
+    if (!is_calibrated) {
+        // Not initialized: calibrated from now on, the SDL rate until then
+        first_ticks = ticks;
+        first_counter = counter;
+        is_calibrated = true;
+    }
+    if (counter > first_counter && ticks > first_ticks) {
+        double elapsed_ms = 1000.0 * (counter - first_counter) / SDL_GetPerformanceFrequency();
+        return (ticks - first_ticks) / elapsed_ms;
+    }
+#endif
+    return SDL_GetPerformanceFrequency() / 1000.0;
+}
+
+void profiler_end_frame(void) {
+    double ticks_per_ms = get_ticks_per_ms();
+    float* frame = history[num_frames % PROFILER_HISTORY];
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        uint64_t ticks = atomic_exchange_explicit(&stage_ticks[stage], 0, memory_order_relaxed);
+        frame[stage] = ticks / ticks_per_ms;
+    }
+    num_frames++;
+
+    if (is_summary_printed && num_frames % PROFILER_HISTORY == 0) {
+        print_profile_summary();
+    }
+}
+
+void set_profile_summary(bool is_printed) {
+    is_summary_printed = is_printed;
+}
+bool get_profile_summary(void) {
+    return is_summary_printed;
+}
+
+void print_profile_summary(void) {
+    int count = num_frames < PROFILER_HISTORY ? num_frames : PROFILER_HISTORY;
+    if (count == 0) {
+        return;
+    }
+    printf("[PROFILE] Mean over the last %d frames (ms):", count);
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        float total = 0.0f;
+        for (int i = 0; i < count; i++) {
+            total += history[i][stage];
+        }
+        printf(" %s %.3f", stage_names[stage], total / count);
+    }
+    printf("\n");
+}
+
+bool save_profile_csv(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Cannot open %s\n", path);
+        return false;
+    }
+    fprintf(file, "frame");
+    for (int stage = 0; stage < NUM_STAGES; stage++) {
+        fprintf(file, ",%s_ms", stage_names[stage]);
+    }
+    fprintf(file, "\n");
+
+    int first = num_frames < PROFILER_HISTORY ? 0 : num_frames - PROFILER_HISTORY;
+    for (int frame = first; frame < num_frames; frame++) {
+        fprintf(file, "%d", frame);
+        for (int stage = 0; stage < NUM_STAGES; stage++) {
+            fprintf(file, ",%.4f", history[frame % PROFILER_HISTORY][stage]);
+        }
+        fprintf(file, "\n");
+    }
+    bool is_written = !ferror(file);
+    return fclose(file) == 0 && is_written;
+}
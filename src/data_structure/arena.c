@@ -0,0 +1,110 @@
+#include <omp.h>
+#include <stdlib.h>
+#include "arena.h"
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t size;  // Bytes of data
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) unsigned char data[];
+};
+
+#define ALIGN_UP(size) (((size) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Arena =======================================================================
+
+static arena_chunk_t* allocate_chunk(arena_t* arena, size_t size) {
+    arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    arena->reserved += size;
+    arena->num_chunk_allocations++;
+    return chunk;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = ALIGN_UP(size);
+    arena_chunk_t* chunk = arena->current;
+    // Next chunk kept from the previous frames large enough, or a new one at the end
+    while (chunk == NULL || chunk->used + size > chunk->size) {
+        arena_chunk_t* next = chunk != NULL ? chunk->next : arena->first;
+        if (next == NULL) {
+            next = allocate_chunk(arena, size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+            if (next == NULL) {
+                return NULL;
+            }
+            if (chunk != NULL) {
+                chunk->next = next;
+            } else {
+                arena->first = next;
+            }
+        }
+        chunk = next;
+    }
+    arena->current = chunk;
+    void* memory = chunk->data + chunk->used;
+    chunk->used += size;
+    arena->used += size;
+    return memory;
+}
+
+void arena_reset(arena_t* arena) {
+    for (arena_chunk_t* chunk = arena->first; chunk != NULL; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+void arena_free(arena_t* arena) {
+    arena_chunk_t* chunk = arena->first;
+    while (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    *arena = (arena_t){0};
+}
+
+// Frame Arena =================================================================
+
+void initialize_frame_arena(frame_arena_t* frame_arena) {
+    frame_arena->num_threads = omp_get_max_threads();
+    frame_arena->threads = calloc(frame_arena->num_threads, sizeof(arena_t));
+    frame_arena->high_water_mark = 0;
+}
+
+void reset_frame_arena(frame_arena_t* frame_arena) {
+    arena_stats_t stats = get_frame_arena_stats(frame_arena);
+    frame_arena->high_water_mark = stats.high_water_mark;
+    for (int i = 0; i < frame_arena->num_threads; i++) {
+        arena_reset(&frame_arena->threads[i]);
+    }
+}
+
+arena_t* get_thread_arena(frame_arena_t* frame_arena) {
+    return &frame_arena->threads[omp_get_thread_num() % frame_arena->num_threads];
+}
+
+arena_stats_t get_frame_arena_stats(const frame_arena_t* frame_arena) {
+    arena_stats_t stats = {0};
+    for (int i = 0; i < frame_arena->num_threads; i++) {
+        stats.used += frame_arena->threads[i].used;
+        stats.reserved += frame_arena->threads[i].reserved;
+        stats.num_chunk_allocations += frame_arena->threads[i].num_chunk_allocations;
+    }
+    stats.high_water_mark = stats.used > frame_arena->high_water_mark ? stats.used : frame_arena->high_water_mark;
+    return stats;
+}
+
+void free_frame_arena(frame_arena_t* frame_arena) {
+    for (int i = 0; i < frame_arena->num_threads; i++) {
+        arena_free(&frame_arena->threads[i]);
+    }
+    free(frame_arena->threads);
+    *frame_arena = (frame_arena_t){0};
+}
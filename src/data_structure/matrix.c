@@ -1,9 +1,26 @@
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
-#include <immintrin.h>
 #include "matrix.h"
 #include "vector.h"
-#include <omp.h>
+
+/*
+* SIMD kernels
+* ------------
+* A 4x4 product is 16 multiply-adds: far too little work for a parallel
+* region, so the kernels below use SSE registers instead of threads. Every
+* lane does the same products added in the same order as the scalar loops
+* (no FMA contraction), so the fast paths give the same floats.
+*
+* The batch transform has an AVX path that does two vertices per register.
+* It is compiled with a target attribute and only taken when the host
+* reports AVX (checked once, like raster_has_avx2()).
+*/
+#if defined(__GNUC__) && defined(__SSE__)
+#define HAS_SIMD_KERNELS 1
+#include <immintrin.h>
+#define AVX_TARGET __attribute__((target("avx")))
+#endif
 
 // Create Matrix Functions ======================================
 
@@ -83,7 +100,7 @@ mat4_t mat4_make_perspective(float fov, float aspect, float z_near, float z_far)
 
 vec4_t mat4_mul_vec4_project(mat4_t mat_proj, vec4_t v) {
     // Multiply the vector by the projection matrix
-    vec4_t result = mat4_mult_vec4(mat_proj, v);
+    vec4_t result = expimental__mat4_mult_vec4_fast(mat_proj, v);
     if (result.data[3] != 0.0f) {
         // Nomalize the vector between -1 and 1
         result.data[0] /= result.data[3];
@@ -108,7 +125,6 @@ void mat4_print(mat4_t matrix) {
 
 mat4_t mat4_mult(mat4_t a, mat4_t b) {
     mat4_t result = {0};
-    #pragma omp parallel for
     for (int row = 0; row < 4; row++) {
         for (int col = 0; col < 4; col++) {
             float sum = 0.0f;
@@ -121,11 +137,31 @@ mat4_t mat4_mult(mat4_t a, mat4_t b) {
     return result;
 }
 
+mat4_t expimental__mat4_mult_fast(mat4_t a, mat4_t b) {
+#ifdef HAS_SIMD_KERNELS
+    // Row r of the result is a[r][0] * b_row0 + ... + a[r][3] * b_row3
+    mat4_t result;
+    __m128 b_rows[4];
+    for (int i = 0; i < 4; i++) {
+        b_rows[i] = _mm_loadu_ps(&b.data[i * 4]);
+    }
+    for (int row = 0; row < 4; row++) {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps(a.data[row * 4 + 0]), b_rows[0]);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.data[row * 4 + 1]), b_rows[1]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.data[row * 4 + 2]), b_rows[2]));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.data[row * 4 + 3]), b_rows[3]));
+        _mm_storeu_ps(&result.data[row * 4], sum);
+    }
+    return result;
+#else
+    return mat4_mult(a, b);
+#endif
+}
+
 // Matrix Vector Functions ======================================
 
 vec4_t mat4_mult_vec4(mat4_t m, vec4_t v) {
     vec4_t result = {0};
-    #pragma omp parallel for
     for (int row = 0; row < 4; row++) {
         float sum = 0.0f;
         for (int i = 0; i < 4; i++) {
@@ -135,3 +171,80 @@ vec4_t mat4_mult_vec4(mat4_t m, vec4_t v) {
     }
     return result;
 }
+
+#ifdef HAS_SIMD_KERNELS
+
+// Columns of m, so that m * v = col0 * x + col1 * y + col2 * z + col3 * w
+static inline void load_columns(const mat4_t* m, __m128 columns[4]) {
+    columns[0] = _mm_loadu_ps(&m->data[0]);
+    columns[1] = _mm_loadu_ps(&m->data[4]);
+    columns[2] = _mm_loadu_ps(&m->data[8]);
+    columns[3] = _mm_loadu_ps(&m->data[12]);
+    _MM_TRANSPOSE4_PS(columns[0], columns[1], columns[2], columns[3]);
+}
+
+static inline __m128 transform_sse(const __m128 columns[4], __m128 v) {
+    __m128 sum = _mm_mul_ps(columns[0], _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(columns[1], _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+    sum = _mm_add_ps(sum, _mm_mul_ps(columns[2], _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+    sum = _mm_add_ps(sum, _mm_mul_ps(columns[3], _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+    return sum;
+}
+
+static bool has_avx(void) {
+    static int has_avx = -1;
+    if (has_avx < 0) {
+        __builtin_cpu_init();
+        has_avx = __builtin_cpu_supports("avx");
+    }
+    return has_avx;
+}
+
+// Two vertices per register, one in each 128-bit lane
+AVX_TARGET static int transform_batch_avx(const mat4_t* m, const vec4_t* in, vec4_t* out, int n) {
+    __m128 columns[4];
+    load_columns(m, columns);
+    __m256 column_0 = _mm256_set_m128(columns[0], columns[0]);
+    __m256 column_1 = _mm256_set_m128(columns[1], columns[1]);
+    __m256 column_2 = _mm256_set_m128(columns[2], columns[2]);
+    __m256 column_3 = _mm256_set_m128(columns[3], columns[3]);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m256 v = _mm256_loadu_ps(in[i].data);
+        __m256 sum = _mm256_mul_ps(column_0, _mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(column_1, _mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1))));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(column_2, _mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2))));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(column_3, _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3))));
+        _mm256_storeu_ps(out[i].data, sum);
+    }
+    return i;
+}
+
+#endif
+
+vec4_t expimental__mat4_mult_vec4_fast(mat4_t m, vec4_t v) {
+#ifdef HAS_SIMD_KERNELS
+    __m128 columns[4];
+    load_columns(&m, columns);
+    vec4_t result;
+    _mm_storeu_ps(result.data, transform_sse(columns, _mm_loadu_ps(v.data)));
+    return result;
+#else
+    return mat4_mult_vec4(m, v);
+#endif
+}
+
+void mat4_mult_vec4_batch(const mat4_t* m, const vec4_t* in, vec4_t* out, int n) {
+#ifdef HAS_SIMD_KERNELS
+    int i = has_avx() ? transform_batch_avx(m, in, out, n) : 0;
+    __m128 columns[4];
+    load_columns(m, columns);
+    for (; i < n; i++) {
+        _mm_storeu_ps(out[i].data, transform_sse(columns, _mm_loadu_ps(in[i].data)));
+    }
+#else
+    for (int i = 0; i < n; i++) {
+        out[i] = mat4_mult_vec4(*m, in[i]);
+    }
+#endif
+}
@@ -0,0 +1,58 @@
+#include <stdlib.h>
+#include <string.h>
+#include "vertex_stream.h"
+#include "vector.h"
+
+// Zeroed block of capacity floats
+static float* allocate_stream(int capacity) {
+    size_t size = sizeof(float) * capacity;
+#ifdef _WIN32
+    float* stream = _aligned_malloc(size, VERTEX_STREAM_ALIGNMENT);
+#else
+    float* stream = aligned_alloc(VERTEX_STREAM_ALIGNMENT, size);
+#endif
+    if (stream != NULL) {
+        memset(stream, 0, size);
+    }
+    return stream;
+}
+
+static void free_stream(float* stream) {
+#ifdef _WIN32
+    _aligned_free(stream);
+#else
+    free(stream);
+#endif
+}
+
+vertex_stream_t create_vertex_stream(int count, bool has_w) {
+    vertex_stream_t stream = {0};
+    if (count <= 0) {
+        return stream;
+    }
+    stream.count = count;
+    stream.capacity = (count + VERTEX_STREAM_WIDTH - 1) / VERTEX_STREAM_WIDTH * VERTEX_STREAM_WIDTH;
+    stream.x = allocate_stream(stream.capacity);
+    stream.y = allocate_stream(stream.capacity);
+    stream.z = allocate_stream(stream.capacity);
+    if (has_w) {
+        stream.w = allocate_stream(stream.capacity);
+    }
+    return stream;
+}
+
+vertex_stream_t create_vertex_stream_from_vec3(const vec3_t* vertices, int count) {
+    vertex_stream_t stream = create_vertex_stream(count, false);
+    for (int i = 0; i < count; i++) {
+        set_vertex_stream_vec3(&stream, i, vertices[i]);
+    }
+    return stream;
+}
+
+void free_vertex_stream(vertex_stream_t* stream) {
+    free_stream(stream->x);
+    free_stream(stream->y);
+    free_stream(stream->z);
+    free_stream(stream->w);
+    *stream = (vertex_stream_t){0};
+}
@@ -0,0 +1,84 @@
+#include "scene.h"
+#include "camera.h"
+#include "entity.h"
+#include "mesh.h"
+#include "vector.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PI 3.14159265
+
+typedef struct {
+    const char* name;
+    void (*load)(void);
+    // Scripted camera: orbit around the center, looking at it
+    vec3_t center;
+    float radius;
+    float height;  // Of the camera above the center
+} scene_t;
+
+static void load_planes(void) {
+    // Entities
+    load_entity("./assets/planes/f22", (vec3_t){1, 1, 1}, (vec3_t){0, -1.3, +5}, (vec3_t){0, -PI/2, 0});
+    load_entity("./assets/planes/f117", (vec3_t){1, 1, 1}, (vec3_t){2, -1.3, +9}, (vec3_t){0, -PI/2, 0});
+    load_entity("./assets/planes/efa", (vec3_t){1, 1, 1}, (vec3_t){-2, -1.3, +9}, (vec3_t){0, -PI/2, 0});
+
+    // Props
+    load_prop("./assets/planes/runway", (vec3_t){1, 0, 1}, (vec3_t){0, -1.5, +23}, (vec3_t){0, 0, 0});
+}
+
+// The loose meshes have no texture: drawn with the face color in the textured modes
+static void load_cube(void) {
+    load_mesh("./assets/cube.obj", NULL, (vec3_t){1, 1, 1}, (vec3_t){0, 0, 0}, (vec3_t){0, 0, 0});
+}
+
+static void load_sphere(void) {
+    load_mesh("./assets/sphere.obj", NULL, (vec3_t){1, 1, 1}, (vec3_t){0, 0, 0}, (vec3_t){0, 0, 0});
+}
+
+static void load_teapot(void) {
+    load_mesh("./assets/teapot.obj", NULL, (vec3_t){1, 1, 1}, (vec3_t){0, 0, 0}, (vec3_t){0, 0, 0});
+}
+
+static const scene_t scenes[] = {
+    // Starts where the interactive camera always did: at the origin, looking down +z
+    { "planes", load_planes, { 0, 0, 9 }, 9.0f, 0.0f },
+    { "cube", load_cube, { 0, 0, 0 }, 5.0f, 2.0f },
+    { "sphere", load_sphere, { 0, 0, 0 }, 7.0f, 2.0f },
+    { "teapot", load_teapot, { 0.2, 1.5, 0 }, 9.0f, 3.0f },
+};
+static const scene_t* current_scene = NULL;
+
+bool load_scene(const char* name) {
+    for (size_t i = 0; i < sizeof(scenes) / sizeof(scenes[0]); i++) {
+        if (strcmp(scenes[i].name, name) == 0) {
+            current_scene = &scenes[i];
+            current_scene->load();
+            update_scene_camera(0.0f);
+            return true;
+        }
+    }
+    fprintf(stderr, "[ERROR] Unknown scene: %s\n", name);
+    return false;
+}
+
+void update_scene_camera(float t) {
+    if (current_scene == NULL) {
+        return;
+    }
+    float angle = 2 * PI * t;
+    vec3_t position = {
+        current_scene->center.x + current_scene->radius * sin(angle),
+        current_scene->center.y + current_scene->height,
+        current_scene->center.z - current_scene->radius * cos(angle)
+    };
+    update_camera_position(position);
+
+    // The look-at target is +z rotated by the pitch (x axis) then the yaw (y axis)
+    vec3_t direction = vec3_sub(current_scene->center, position);
+    float yaw = atan2(direction.x, direction.z);
+    float pitch = atan2(-direction.y, sqrt(direction.x * direction.x + direction.z * direction.z));
+    rotate_camera_yaw(yaw - get_camera_yaw_angle());
+    rotate_camera_pitch(pitch - get_camera_pitch_angle());
+}
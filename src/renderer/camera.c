@@ -9,7 +9,9 @@ static camera_t camera = {
     .direction = { .x = 0, .y = 0, .z = 1 },
     .forward_velocity = { .x = 0, .y = 0, .z = 0 },
     .yaw_angle = 0.0,
-    .pitch_angle = 0.0
+    .pitch_angle = 0.0,
+    .is_view_dirty = true,
+    .view_version = 0
 };
 
 
@@ -17,6 +19,7 @@ static camera_t camera = {
 void init_camera(vec3_t position, vec3_t direction) {
     camera.position = position;
     camera.direction = direction;
+    camera.is_view_dirty = true;
 }
 vec3_t get_camera_position(void) {
     return camera.position;
@@ -29,7 +32,10 @@ vec3_t get_camera_forward_velocity(void) {
 }
 
 void update_camera_position(vec3_t position) {
-    camera.position = position;
+    if (position.x != camera.position.x || position.y != camera.position.y || position.z != camera.position.z) {
+        camera.position = position;
+        camera.is_view_dirty = true;
+    }
 }
 void update_camera_direction(vec3_t direction) {
     camera.direction = direction;
@@ -46,11 +52,17 @@ float get_camera_pitch_angle(void) {
 }
 
 void rotate_camera_yaw(float angle) {
-    camera.yaw_angle += angle;
+    if (angle != 0.0f) {
+        camera.yaw_angle += angle;
+        camera.is_view_dirty = true;
+    }
 }
 
 void rotate_camera_pitch(float angle) {
-    camera.pitch_angle += angle;
+    if (angle != 0.0f) {
+        camera.pitch_angle += angle;
+        camera.is_view_dirty = true;
+    }
 }
 
 mat4_t mat4_look_at(vec3_t eye, vec3_t target) {
@@ -95,3 +107,22 @@ vec3_t get_camera_lookat_target(void) {
     return target;
 }
 
+static void update_view_matrix(void) {
+    if (!camera.is_view_dirty) {
+        return;
+    }
+    vec3_t target = get_camera_lookat_target();
+    camera.view_matrix = mat4_look_at(camera.position, target);
+    camera.is_view_dirty = false;
+    camera.view_version++;
+}
+
+mat4_t get_camera_view_matrix(void) {
+    update_view_matrix();
+    return camera.view_matrix;
+}
+
+int get_camera_view_version(void) {
+    update_view_matrix();
+    return camera.view_version;
+}
@@ -38,6 +38,10 @@ void initialize_frustum_planes(float fovy, float fovx, float z_near, float z_far
     frustplanes[FAR_FRUSTUM_PLANE].normal = (vec3_t) {0, 0, -1};
 }
 
+plane_t get_frustum_plane(int plane_index) {
+    return frustplanes[plane_index];
+}
+
 
 void clip_polygon_against_plane(polygon_t* polygon, int plane_index) {
     vec3_t plane_point = frustplanes[plane_index].point;
@@ -130,7 +134,7 @@ void create_triangles_from_polygon(
     polygon_t* polygon,
     triangle_t* clipped_triangles,
     int* num_clipped_triangles,
-    upng_t* texture
+    texture_t* texture
 ) {
      for (int i = 0; i < polygon->num_vertices - 2; i++) {
          int index0 = 0;
@@ -1,4 +1,5 @@
 #include "display.h"
+#include "profiler.h"
 #include "triangle.h"
 #include "vector.h"
 #include <math.h>
@@ -6,13 +7,22 @@
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 // Variable ////////////////////////////////////////////////
 static SDL_Window* window;
 static SDL_Renderer* renderer;
 
-static color_t* color_buffer;
-static float* z_buffer;
+static color_t* color_buffer;        // Rendered into when the texture is not locked
+static color_t* frame_pixels;        // Color buffer of the current frame
+static int frame_pitch;              // Bytes between two rows of frame_pixels
+static bool is_texture_locked = false;
+static color_t* presented_pixels = NULL;  // Last frame presented, NULL if it is only in the SDL texture
+static color_t* back_color_buffer;   // Second color buffer of the pipelined present
+static void* z_buffer;  // Big enough for any depth format
+static uint32_t* id_buffer;  // Triangle index of each pixel (visibility buffer)
 
 static SDL_Texture* color_buffer_texture;
 static int window_height;
@@ -21,13 +31,52 @@ static int window_width;
 int render_method = WIREFRAME_AND_VERTEX;
 int light_mode = LIGHT_ON;
 int culling_mode = CULLING_ON;
+int simd_mode = SIMD_ON;
+int subpixel_mode = SUBPIXEL_ON;
+int mapping_mode = MAPPING_PERSPECTIVE;
+int mipmap_mode = MIPMAP_ON;
+int filter_mode = FILTER_NEAREST;
+int depth_format = DEPTH_FLOAT;
+int present_mode = PRESENT_LOCK_TEXTURE;
+int display_backend = BACKEND_WINDOW;
+static depth_range_t depth_range = { 1.0f, 1.0f };
 
 static int window_width = 680;
 static int window_height = 400;
 
+// Clip rectangle of the calling thread, the whole viewport when not set
+static _Thread_local rect_t clip_rect;
+static _Thread_local bool has_clip_rect = false;
+
+// Raster thread of the pipelined present: draws a frame while the previous one is presented
+static SDL_Thread* raster_thread = NULL;
+static SDL_mutex* frame_mutex;
+static SDL_cond* frame_cond;
+static void (*submitted_frame)(void*) = NULL;  // NULL once the raster thread is idle
+static void* submitted_frame_data;
+static bool is_raster_thread_quitting = false;
+static bool has_drawn_frame = false;  // frame_pixels holds a frame not presented yet
+
 
 // initialize display ---------------------------------------------------------
+
+// Allocate the required memory in bytes to hold the buffers of the window size
+static bool allocate_buffers(void) {
+    color_buffer = (color_t*) malloc(sizeof(color_t) * window_width * window_height);
+    back_color_buffer = (color_t*) malloc(sizeof(color_t) * window_width * window_height);
+    frame_pixels = color_buffer;
+    frame_pitch = window_width * sizeof(color_t);
+    z_buffer = malloc(sizeof(uint32_t) * window_width * window_height);
+    id_buffer = (uint32_t*) malloc(sizeof(uint32_t) * window_width * window_height);
+    if (!color_buffer || !back_color_buffer || !z_buffer || !id_buffer) {
+        fprintf(stderr, "Error allocating the frame buffers.\n");
+        return false;
+    }
+    return true;
+}
+
 bool initialize_window(bool is_fullscreen, bool is_retro_look) {
+    display_backend = BACKEND_WINDOW;
     if (SDL_Init(SDL_INIT_EVERYTHING) != 0) {
         fprintf(stderr, "Error initializing SDL.\n");
         return false;
@@ -73,14 +122,15 @@ bool initialize_window(bool is_fullscreen, bool is_retro_look) {
         SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN);
     }
 
-    // Allocate the required memory in bytes to hold the color buffer
-    color_buffer = (color_t*) malloc(sizeof(color_t) * window_width * window_height);
-    z_buffer = (float*) malloc(sizeof(float) * window_width * window_height);
-    
+    if (!allocate_buffers()) {
+        return false;
+    }
+
     // Creating a SDL texture that is used to display the color buffer
+    // Same packing as color_t (0xAARRGGBB): SDL never converts the pixels
     color_buffer_texture = SDL_CreateTexture(
         renderer,
-        SDL_PIXELFORMAT_RGBA32,
+        SDL_PIXELFORMAT_ARGB8888,
         SDL_TEXTUREACCESS_STREAMING,
         window_width,
         window_height
@@ -102,9 +152,22 @@ bool initialize_window(bool is_fullscreen, bool is_retro_look) {
     return true;
 }
 
+bool initialize_offscreen(int width, int height) {
+    display_backend = BACKEND_OFFSCREEN;
+    window_width = width;
+    window_height = height;
+    return allocate_buffers();
+}
+
 void destroy_window(void) {
+    stop_raster_thread();
     free(color_buffer);
+    free(back_color_buffer);
     free(z_buffer);
+    free(id_buffer);
+    if (display_backend == BACKEND_OFFSCREEN) {
+        return;
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
@@ -140,49 +203,131 @@ int get_culling_mode(void) {
     return culling_mode;
 }
 
-float get_z_buffer(int x, int y) {
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
-        return 1.0;
-    }
-    return z_buffer[(window_width * y) + x];
+void set_simd_mode(int mode) {
+    simd_mode = mode;
 }
-void update_z_buffer(int x, int y, float z) {
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
-        return;
-    }
-    z_buffer[(window_width * y) + x] = z;
+int get_simd_mode(void) {
+    return simd_mode;
 }
 
+void set_subpixel_mode(int mode) {
+    subpixel_mode = mode;
+}
+int get_subpixel_mode(void) {
+    return subpixel_mode;
+}
 
-// Draw grid ------------------------------------------------------------------
+void set_mapping_mode(int mode) {
+    mapping_mode = mode;
+}
+int get_mapping_mode(void) {
+    return mapping_mode;
+}
 
-void draw_grid(void) {
-    for (int y = 0; y < window_height; y++) {
-        for (int x = 0; x < window_width; x++) {
-            if (y % 20 == 0 || x % 20 == 0) {
-                draw_pixel(x, y, 0xFF333333);
-            }
-        }
+void set_mipmap_mode(int mode) {
+    mipmap_mode = mode;
+}
+int get_mipmap_mode(void) {
+    return mipmap_mode;
+}
+
+void set_filter_mode(int mode) {
+    filter_mode = mode;
+}
+int get_filter_mode(void) {
+    return filter_mode;
+}
+
+void set_depth_format(int format) {
+    depth_format = format;
+}
+int get_depth_format(void) {
+    return depth_format;
+}
+
+void set_depth_range(float z_near, float z_far) {
+    depth_range.near_inverse = 1.0f / z_near;
+    depth_range.scale = 1.0f / (1.0f / z_near - 1.0f / z_far);
+}
+depth_range_t get_depth_range(void) {
+    return depth_range;
+}
+
+raster_settings_t get_raster_settings(void) {
+    return (raster_settings_t){
+        .simd_mode = simd_mode,
+        .subpixel_mode = subpixel_mode,
+        .mapping_mode = mapping_mode,
+        .mipmap_mode = mipmap_mode,
+        .filter_mode = filter_mode,
+        .depth_format = depth_format,
+        .depth_range = depth_range
+    };
+}
+
+void set_present_mode(int mode) {
+    present_mode = mode;
+}
+int get_present_mode(void) {
+    return present_mode;
+}
+
+int get_display_backend(void) {
+    return display_backend;
+}
+
+static int get_depth_size(int format) {
+    return format == DEPTH_UNORM16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// Far depth of a format, as stored in the buffer
+static uint32_t get_depth_clear_value(int format) {
+    union { float f; uint32_t u; } value;
+    switch (format) {
+        case DEPTH_UNORM16: return 0xFFFF;
+        case DEPTH_UNORM24: return 0xFFFFFF;
+        case DEPTH_REVERSED_FLOAT: value.f = 0.0f; return value.u;
+        default: value.f = 1.0f; return value.u;
     }
 }
 
-void draw_ref(void) {
-    for (int y = 0; y < window_height; y++) {
-        for (int x = 0; x < window_width; x++) {
-            if (y % 20 == 0 && x % 20 == 0) {
-                draw_pixel(x, y, 0xFF333333);
-            }
-        }
+color_t* get_color_buffer_row(int y) {
+    return (color_t*)((uint8_t*)frame_pixels + (size_t)frame_pitch * y);
+}
+void* get_z_buffer_row(int y, int format) {
+    return (uint8_t*)z_buffer + (size_t)window_width * y * get_depth_size(format);
+}
+uint32_t* get_id_buffer_row(int y) {
+    return &id_buffer[window_width * y];
+}
+
+
+// Clipping -------------------------------------------------------------------
+
+void set_clip_rect(rect_t rect) {
+    clip_rect = rect;
+    has_clip_rect = true;
+}
+
+void reset_clip_rect(void) {
+    has_clip_rect = false;
+}
+
+rect_t get_clip_rect(void) {
+    if (!has_clip_rect) {
+        return (rect_t){ 0, 0, window_width - 1, window_height - 1 };
     }
+    return clip_rect;
 }
 
 // Draw pixel -----------------------------------------------------------------
 
 void draw_pixel(int x, int y, color_t color) {
-    if (x < 0 || x >= window_width || y < 0 || y >= window_height) {
+    rect_t clip = get_clip_rect();
+    if (x < clip.x_min || x > clip.x_max || y < clip.y_min || y > clip.y_max) {
         return;
     }
-    color_buffer[(window_width * y) + x] = color;
+    get_color_buffer_row(y)[x] = color;
 }
 
 // Draw rect ------------------------------------------------------------------
@@ -195,87 +340,314 @@ void draw_rec(int x, int y, int w, int h, color_t color) {
     }
 }
 
-// Draw line ------------------------------------------------------------------
+// Raster thread ---------------------------------------------------------------
 
-void draw_line_dda(vec2_t start, vec2_t end, color_t color) {
-    int delta_x = (end.x - start.x);
-    int delta_y = (end.y - start.y);
+static int raster_thread_loop(void* data) {
+    (void)data;
+    SDL_LockMutex(frame_mutex);
+    while (true) {
+        while (submitted_frame == NULL && !is_raster_thread_quitting) {
+            SDL_CondWait(frame_cond, frame_mutex);
+        }
+        if (submitted_frame == NULL) {
+            break;
+        }
+        SDL_UnlockMutex(frame_mutex);
+        submitted_frame(submitted_frame_data);
+        SDL_LockMutex(frame_mutex);
+        submitted_frame = NULL;
+        SDL_CondBroadcast(frame_cond);
+    }
+    SDL_UnlockMutex(frame_mutex);
+    return 0;
+}
 
-    int side_len = abs(delta_x) >= abs(delta_y) ? abs(delta_x) : abs(delta_y);
+static bool start_raster_thread(void) {
+    frame_mutex = SDL_CreateMutex();
+    frame_cond = SDL_CreateCond();
+    if (frame_mutex != NULL && frame_cond != NULL) {
+        is_raster_thread_quitting = false;
+        raster_thread = SDL_CreateThread(raster_thread_loop, "raster", NULL);
+    }
+    if (raster_thread == NULL) {
+        fprintf(stderr, "[WARNING] - Cannot start the raster thread, frames are drawn then presented.\n");
+        SDL_DestroyCond(frame_cond);
+        SDL_DestroyMutex(frame_mutex);
+        present_mode = PRESENT_UPDATE_TEXTURE;
+        return false;
+    }
+    return true;
+}
 
-    float x_inc = delta_x / (float)side_len;
-    float y_inc = delta_y / (float)side_len;
+// Block until the raster thread is done with the submitted frame
+static void wait_raster_thread(void) {
+    if (raster_thread == NULL) {
+        return;
+    }
+    SDL_LockMutex(frame_mutex);
+    while (submitted_frame != NULL) {
+        SDL_CondWait(frame_cond, frame_mutex);
+    }
+    SDL_UnlockMutex(frame_mutex);
+}
 
-    float current_x = start.x;
-    float current_y = start.y;
+static void submit_frame(void (*draw_frame)(void*), void* data) {
+    SDL_LockMutex(frame_mutex);
+    submitted_frame = draw_frame;
+    submitted_frame_data = data;
+    SDL_CondBroadcast(frame_cond);
+    SDL_UnlockMutex(frame_mutex);
+}
 
-    for (int i = 0; i < side_len; i++) {
-        draw_pixel(round(current_x), round(current_y), color);
-        current_x += x_inc;
-        current_y += y_inc;
+// The frame being drawn is finished first, the drawn one is never presented
+void stop_raster_thread(void) {
+    if (raster_thread == NULL) {
+        return;
     }
+    wait_raster_thread();
+    SDL_LockMutex(frame_mutex);
+    is_raster_thread_quitting = true;
+    SDL_CondBroadcast(frame_cond);
+    SDL_UnlockMutex(frame_mutex);
+    SDL_WaitThread(raster_thread, NULL);
+    SDL_DestroyCond(frame_cond);
+    SDL_DestroyMutex(frame_mutex);
+    raster_thread = NULL;
+    has_drawn_frame = false;
 }
 
-void draw_line_bresenham(int x0, int y0, int x1, int y1, color_t color) {
-    int dx = abs(x1 - x0);
-    int sx = x0 < x1 ? 1 : -1;
-    int dy = -abs(y1 - y0);
-    int sy = y0 < y1 ? 1 : -1;
-    int error = dx + dy;
+// Buffer helper functions ----------------------------------------------------
 
-    while (true) {
-        draw_pixel(x0, y0, color);
-        if (x0 == x1 && y0 == y1) break;
-        int e2 = 2*error;
-        if (e2 > dy) {
-            if (x0 == x1) break;
-            error += dy;
-            x0 += sx;
-        }
-        if (e2 <= dx) {
-            if (y0 == y1) break;
-            error += dx;
-            y0 += sy;
+void prepare_color_buffer(void) {
+    frame_pixels = color_buffer;
+    frame_pitch = window_width * sizeof(color_t);
+    if (present_mode != PRESENT_LOCK_TEXTURE || display_backend == BACKEND_OFFSCREEN) {
+        return;
+    }
+
+    // The locked pixels are write only and undefined: every pixel is cleared by the tiles
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(color_buffer_texture, NULL, &pixels, &pitch) == 0) {
+        frame_pixels = pixels;
+        frame_pitch = pitch;
+        is_texture_locked = true;
+    }
+}
+
+static void present_color_buffer(color_t* pixels) {
+    if (display_backend == BACKEND_OFFSCREEN) {
+        // Nothing to upload: the frame stays in its buffer until the next present
+        presented_pixels = pixels;
+        return;
+    }
+    PROFILE_BEGIN(STAGE_PRESENT);
+    if (is_texture_locked) {
+        SDL_UnlockTexture(color_buffer_texture);
+        is_texture_locked = false;
+        presented_pixels = NULL;
+    } else {
+        presented_pixels = pixels;
+        SDL_UpdateTexture(
+            color_buffer_texture,
+            NULL,
+            pixels,
+            (int)(window_width * sizeof(color_t))
+        );
+    }
+    SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL); // Will scale the color_buffer!
+    SDL_RenderPresent(renderer);
+    PROFILE_END(STAGE_PRESENT);
+}
+
+void render_color_buffer(void) {
+    present_color_buffer(color_buffer);
+}
+
+/*
+* Pipelined present: the raster thread draws the frame in one color buffer
+* while this thread uploads and presents the previous frame from the other one.
+* SDL only accepts render calls from the thread that created the renderer,
+* so the drawing moves to the raster thread and the present stays here.
+* At most one frame is queued: the call blocks until the previous frame is drawn.
+*/
+static void render_frame_pipelined(void (*draw_frame)(void*), void* data) {
+    wait_raster_thread();
+    color_t* drawn_pixels = frame_pixels;
+    bool is_frame_drawn = has_drawn_frame;
+
+    // The raster thread is idle: the buffer of the next frame can be swapped in
+    frame_pixels = (frame_pixels == color_buffer) ? back_color_buffer : color_buffer;
+    frame_pitch = window_width * sizeof(color_t);
+    submit_frame(draw_frame, data);
+    has_drawn_frame = true;
+
+    if (is_frame_drawn) {
+        present_color_buffer(drawn_pixels);
+    }
+}
+
+void render_frame(void (*draw_frame)(void*), void* data) {
+    if (present_mode == PRESENT_PIPELINED && (raster_thread != NULL || start_raster_thread())) {
+        render_frame_pipelined(draw_frame, data);
+        return;
+    }
+
+    // Leaving the pipelined present: the frame in flight is dropped
+    wait_raster_thread();
+    has_drawn_frame = false;
+
+    prepare_color_buffer();
+    draw_frame(data);
+    render_color_buffer();
+}
+
+void finish_frame(void) {
+    wait_raster_thread();
+    if (has_drawn_frame) {
+        present_color_buffer(frame_pixels);
+        has_drawn_frame = false;
+    }
+}
+
+color_t* get_presented_frame(void) {
+    return presented_pixels;
+}
+
+int count_drawn_pixels(color_t clear_color) {
+    if (presented_pixels == NULL) {
+        return 0;
+    }
+    int num_pixels = 0;
+    for (int y = 0; y < window_height; y++) {
+        const color_t* color_row = &presented_pixels[window_width * y];
+        for (int x = 0; x < window_width; x++) {
+            bool is_ref = y % REF_SPACING == 0 && x % REF_SPACING == 0;
+            num_pixels += color_row[x] != (is_ref ? REF_COLOR : clear_color);
         }
     }
+    return num_pixels;
 }
 
+bool save_frame_ppm(const char* path) {
+    if (presented_pixels == NULL) {
+        fprintf(stderr, "[ERROR] No frame to save in %s (the frame is only in the SDL texture).\n", path);
+        return false;
+    }
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "[ERROR] Cannot open %s.\n", path);
+        return false;
+    }
 
-void draw_line(vec2_t start, vec2_t end, color_t color) {
-    draw_line_bresenham(start.x, start.y, end.x, end.y, color);   
+    // Binary PPM: 8 bits RGB, rows from the top
+    fprintf(file, "P6\n%d %d\n255\n", window_width, window_height);
+    uint8_t* rgb_row = malloc(3 * window_width);
+    for (int y = 0; y < window_height; y++) {
+        const color_t* color_row = &presented_pixels[window_width * y];
+        for (int x = 0; x < window_width; x++) {
+            rgb_row[3 * x + 0] = (color_row[x] >> 16) & 0xFF;
+            rgb_row[3 * x + 1] = (color_row[x] >> 8) & 0xFF;
+            rgb_row[3 * x + 2] = color_row[x] & 0xFF;
+        }
+        fwrite(rgb_row, 3, window_width, file);
+    }
+    free(rgb_row);
+    bool is_written = !ferror(file);
+    return fclose(file) == 0 && is_written;
 }
 
-void draw_triangle(triangle_t triangle, color_t color) {
-    for (int v = 0; v < 3; v++) {
-        vec2_t start = { .x = triangle.points[v].data[0], .y = triangle.points[v].data[1] };
-        vec2_t end = { .x = triangle.points[(v+1)%3].data[0], .y = triangle.points[(v+1)%3].data[1] };
-        draw_line(start, end, color);
+// Reference dots (every REF_SPACING pixels) in a cleared row
+static void draw_ref_row(color_t* color_row, rect_t rect) {
+    int x = ((rect.x_min + REF_SPACING - 1) / REF_SPACING) * REF_SPACING;
+    for (; x <= rect.x_max; x += REF_SPACING) {
+        color_row[x] = REF_COLOR;
     }
 }
 
-// Buffer helper functions ----------------------------------------------------
+static void clear_depth_row(int y, int first, int last, uint32_t value, int format) {
+    if (format == DEPTH_UNORM16) {
+        uint16_t* z_row = get_z_buffer_row(y, format);
+        for (int x = first; x <= last; x++) {
+            z_row[x] = (uint16_t)value;
+        }
+    } else {
+        uint32_t* z_row = get_z_buffer_row(y, format);
+        for (int x = first; x <= last; x++) {
+            z_row[x] = value;
+        }
+    }
+}
 
-void render_color_buffer(void) {
-    SDL_UpdateTexture(
-        color_buffer_texture,
-        NULL,
-        color_buffer,
-        (int)(window_width * sizeof(color_t))
-    );
-    SDL_RenderCopy(renderer, color_buffer_texture, NULL, NULL); // Will scale the color_buffer!
-    SDL_RenderPresent(renderer);
+void clear_rect(rect_t rect, color_t color, int format) {
+    uint32_t depth = get_depth_clear_value(format);
+    for (int y = rect.y_min; y <= rect.y_max; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        for (int x = rect.x_min; x <= rect.x_max; x++) {
+            color_row[x] = color;
+        }
+        clear_depth_row(y, rect.x_min, rect.x_max, depth, format);
+        if (y % REF_SPACING == 0) {
+            draw_ref_row(color_row, rect);
+        }
+    }
+}
+
+// Fill [first, last] with value, bypassing the cache where possible
+static void stream_fill(uint32_t* row, int first, int last, uint32_t value) {
+    int x = first;
+#ifdef __SSE2__
+    // Non-temporal stores need 16 bytes alignment
+    for (; x <= last && ((uintptr_t)&row[x] & 15) != 0; x++) {
+        row[x] = value;
+    }
+    __m128i values = _mm_set1_epi32((int)value);
+    for (; x + 3 <= last; x += 4) {
+        _mm_stream_si128((__m128i*)&row[x], values);
+    }
+#endif
+    for (; x <= last; x++) {
+        row[x] = value;
+    }
 }
 
-void clear_color_buffer(color_t color) {
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-    for (int i = 0; i < window_width * window_height; i++) {
-        color_buffer[i] = color;
+// Same for 16 bits values: pairs of values streamed as 32 bits
+static void stream_fill16(uint16_t* row, int first, int last, uint16_t value) {
+    int x = first;
+    if (x <= last && ((uintptr_t)&row[x] & 3) != 0) {
+        row[x++] = value;
+    }
+    int num_pairs = (last - x + 1) / 2;
+    if (num_pairs > 0) {
+        stream_fill((uint32_t*)&row[x], 0, num_pairs - 1, ((uint32_t)value << 16) | value);
+        x += 2 * num_pairs;
+    }
+    if (x <= last) {
+        row[x] = value;
     }
 }
 
-void clear_z_buffer(void) {
-    for (int i = 0; i < window_width * window_height; i++) {
-        z_buffer[i] = 1.0;
+void stream_clear_rect(rect_t rect, color_t color, int format) {
+    uint32_t depth = get_depth_clear_value(format);
+    for (int y = rect.y_min; y <= rect.y_max; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        if (format == DEPTH_UNORM16) {
+            stream_fill16(get_z_buffer_row(y, format), rect.x_min, rect.x_max, (uint16_t)depth);
+        } else {
+            stream_fill(get_z_buffer_row(y, format), rect.x_min, rect.x_max, depth);
+        }
+        if (y % REF_SPACING == 0) {
+            // A row with dots is rare: plain stores
+            for (int x = rect.x_min; x <= rect.x_max; x++) {
+                color_row[x] = color;
+            }
+            draw_ref_row(color_row, rect);
+        } else {
+            stream_fill(color_row, rect.x_min, rect.x_max, color);
+        }
     }
+#ifdef __SSE2__
+    // The streamed lines must be visible to the other threads (and the present)
+    _mm_sfence();
+#endif
 }
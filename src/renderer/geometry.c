@@ -0,0 +1,283 @@
+#include "geometry.h"
+#include "clipping.h"
+#include "display.h"
+#include "matrix.h"
+#include "triangle.h"
+#include "vector.h"
+#include "vertex_stream.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_AVX2_KERNELS 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+// Scalar loops ===============================================================
+
+static void transform_vertex_scalar(const mat4_t* m, const vertex_stream_t* in, vertex_stream_t* out, int i) {
+    float x = in->x[i];
+    float y = in->y[i];
+    float z = in->z[i];
+    const float* d = m->data;
+    out->x[i] = d[0] * x + d[1] * y + d[2] * z + d[3];
+    out->y[i] = d[4] * x + d[5] * y + d[6] * z + d[7];
+    out->z[i] = d[8] * x + d[9] * y + d[10] * z + d[11];
+}
+
+static void project_vertex_scalar(
+    const mat4_t* projection, const vertex_stream_t* in, vertex_stream_t* out,
+    clip_flags_t* clip_flags, float half_width, float half_height, int i
+) {
+    float x = in->x[i];
+    float y = in->y[i];
+    float z = in->z[i];
+    const float* d = projection->data;
+
+    // IMAGE SPACE: w = 1, then the perspective divide
+    float projected_x = d[0] * x + d[1] * y + d[2] * z + d[3];
+    float projected_y = d[4] * x + d[5] * y + d[6] * z + d[7];
+    float projected_z = d[8] * x + d[9] * y + d[10] * z + d[11];
+    float projected_w = d[12] * x + d[13] * y + d[14] * z + d[15];
+    if (projected_w != 0.0f) {
+        projected_x /= projected_w;
+        projected_y /= projected_w;
+        projected_z /= projected_w;
+    }
+
+    // SCREEN SPACE: scale into view, invert the y-axis and move to the middle of the screen
+    projected_x *= half_width;
+    projected_y *= half_height;
+    projected_y *= -1;
+    projected_x += half_width;
+    projected_y += half_height;
+
+    out->x[i] = projected_x;
+    out->y[i] = projected_y;
+    out->z[i] = projected_z;
+    out->w[i] = projected_w;
+
+    // Same test as clip_polygon_against_plane: inside only if the dot is > 0
+    clip_flags_t flags = 0;
+    for (int p = 0; p < NUM_FRUSTUM_PLANES; p++) {
+        plane_t plane = get_frustum_plane(p);
+        vec3_t v = { x, y, z };
+        float dot = vec3_dot_product(vec3_sub(v, plane.point), plane.normal);
+        if (!(dot > 0)) {
+            flags |= (clip_flags_t)(1 << p);
+        }
+    }
+    clip_flags[i] = flags;
+}
+
+static void compute_face_normal_scalar(
+    const face_t* faces, const vertex_stream_t* vertices,
+    vertex_stream_t* normals, bool* is_front_face, int i
+) {
+    vec4_t face_vertices[3] = {
+        vec4_from_vec3(get_vertex_stream_vec3(vertices, faces[i].a)),
+        vec4_from_vec3(get_vertex_stream_vec3(vertices, faces[i].b)),
+        vec4_from_vec3(get_vertex_stream_vec3(vertices, faces[i].c))
+    };
+    vec3_t normal = get_triangle_normal(face_vertices);
+    // Vector between the a point in the triangle and the origin
+    vec3_t camera_ray = vec3_sub((vec3_t){0, 0, 0}, vec3_from_vec4(face_vertices[0]));
+    set_vertex_stream_vec3(normals, i, normal);
+    is_front_face[i] = !(vec3_dot_product(camera_ray, normal) < 0);
+}
+
+// AVX2 kernels ===============================================================
+
+#ifdef HAS_AVX2_KERNELS
+
+static bool has_avx2(void) {
+    static int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2");
+    }
+    return has_avx2;
+}
+
+// One row of m times (x, y, z, 1)
+AVX2_TARGET static inline __m256 transform_row(const float* row, __m256 x, __m256 y, __m256 z) {
+    __m256 sum = _mm256_mul_ps(_mm256_set1_ps(row[0]), x);
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(row[1]), y));
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(row[2]), z));
+    return _mm256_add_ps(sum, _mm256_set1_ps(row[3]));
+}
+
+AVX2_TARGET static void transform_vertex_stream_avx2(const mat4_t* m, const vertex_stream_t* in, vertex_stream_t* out) {
+    for (int i = 0; i < in->capacity; i += VERTEX_STREAM_WIDTH) {
+        __m256 x = _mm256_load_ps(&in->x[i]);
+        __m256 y = _mm256_load_ps(&in->y[i]);
+        __m256 z = _mm256_load_ps(&in->z[i]);
+        _mm256_store_ps(&out->x[i], transform_row(&m->data[0], x, y, z));
+        _mm256_store_ps(&out->y[i], transform_row(&m->data[4], x, y, z));
+        _mm256_store_ps(&out->z[i], transform_row(&m->data[8], x, y, z));
+    }
+}
+
+AVX2_TARGET static void project_vertex_stream_avx2(
+    const mat4_t* projection, const vertex_stream_t* in, vertex_stream_t* out,
+    clip_flags_t* clip_flags, float half_width, float half_height
+) {
+    plane_t planes[NUM_FRUSTUM_PLANES];
+    for (int p = 0; p < NUM_FRUSTUM_PLANES; p++) {
+        planes[p] = get_frustum_plane(p);
+    }
+    const __m256 zero = _mm256_setzero_ps();
+    for (int i = 0; i < in->capacity; i += VERTEX_STREAM_WIDTH) {
+        __m256 x = _mm256_load_ps(&in->x[i]);
+        __m256 y = _mm256_load_ps(&in->y[i]);
+        __m256 z = _mm256_load_ps(&in->z[i]);
+
+        // IMAGE SPACE: the divide is kept only in the lanes where w != 0
+        __m256 projected_x = transform_row(&projection->data[0], x, y, z);
+        __m256 projected_y = transform_row(&projection->data[4], x, y, z);
+        __m256 projected_z = transform_row(&projection->data[8], x, y, z);
+        __m256 projected_w = transform_row(&projection->data[12], x, y, z);
+        __m256 has_w = _mm256_cmp_ps(projected_w, zero, _CMP_NEQ_UQ);
+        projected_x = _mm256_blendv_ps(projected_x, _mm256_div_ps(projected_x, projected_w), has_w);
+        projected_y = _mm256_blendv_ps(projected_y, _mm256_div_ps(projected_y, projected_w), has_w);
+        projected_z = _mm256_blendv_ps(projected_z, _mm256_div_ps(projected_z, projected_w), has_w);
+
+        // SCREEN SPACE
+        projected_x = _mm256_mul_ps(projected_x, _mm256_set1_ps(half_width));
+        projected_y = _mm256_mul_ps(projected_y, _mm256_set1_ps(half_height));
+        projected_y = _mm256_mul_ps(projected_y, _mm256_set1_ps(-1.0f));
+        projected_x = _mm256_add_ps(projected_x, _mm256_set1_ps(half_width));
+        projected_y = _mm256_add_ps(projected_y, _mm256_set1_ps(half_height));
+
+        _mm256_store_ps(&out->x[i], projected_x);
+        _mm256_store_ps(&out->y[i], projected_y);
+        _mm256_store_ps(&out->z[i], projected_z);
+        _mm256_store_ps(&out->w[i], projected_w);
+
+        // One bit per plane where the dot is not > 0
+        __m256i flags = _mm256_setzero_si256();
+        for (int p = 0; p < NUM_FRUSTUM_PLANES; p++) {
+            __m256 dot = _mm256_mul_ps(_mm256_sub_ps(x, _mm256_set1_ps(planes[p].point.x)), _mm256_set1_ps(planes[p].normal.x));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_sub_ps(y, _mm256_set1_ps(planes[p].point.y)), _mm256_set1_ps(planes[p].normal.y)));
+            dot = _mm256_add_ps(dot, _mm256_mul_ps(_mm256_sub_ps(z, _mm256_set1_ps(planes[p].point.z)), _mm256_set1_ps(planes[p].normal.z)));
+            __m256i is_inside = _mm256_castps_si256(_mm256_cmp_ps(dot, zero, _CMP_GT_OQ));
+            flags = _mm256_or_si256(flags, _mm256_andnot_si256(is_inside, _mm256_set1_epi32(1 << p)));
+        }
+        int32_t lane_flags[VERTEX_STREAM_WIDTH];
+        _mm256_storeu_si256((__m256i*)lane_flags, flags);
+        for (int lane = 0; lane < VERTEX_STREAM_WIDTH; lane++) {
+            clip_flags[i + lane] = (clip_flags_t)lane_flags[lane];
+        }
+    }
+}
+
+AVX2_TARGET static inline void normalize_avx2(__m256* x, __m256* y, __m256* z) {
+    __m256 length = _mm256_mul_ps(*x, *x);
+    length = _mm256_add_ps(length, _mm256_mul_ps(*y, *y));
+    length = _mm256_add_ps(length, _mm256_mul_ps(*z, *z));
+    length = _mm256_sqrt_ps(length);
+    *x = _mm256_div_ps(*x, length);
+    *y = _mm256_div_ps(*y, length);
+    *z = _mm256_div_ps(*z, length);
+}
+
+// Returns the number of faces done, the rest (less than 8) is left to the scalar loop
+AVX2_TARGET static int compute_face_normals_avx2(
+    const face_t* faces, int num_faces, const vertex_stream_t* vertices,
+    vertex_stream_t* normals, bool* is_front_face
+) {
+    const __m256i face_offsets = _mm256_mullo_epi32(
+        _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)sizeof(face_t)));
+    const __m256 zero = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + VERTEX_STREAM_WIDTH <= num_faces; i += VERTEX_STREAM_WIDTH) {
+        const char* face = (const char*)&faces[i];
+        __m256i index_a = _mm256_i32gather_epi32((const int*)(face + offsetof(face_t, a)), face_offsets, 1);
+        __m256i index_b = _mm256_i32gather_epi32((const int*)(face + offsetof(face_t, b)), face_offsets, 1);
+        __m256i index_c = _mm256_i32gather_epi32((const int*)(face + offsetof(face_t, c)), face_offsets, 1);
+        __m256 a_x = _mm256_i32gather_ps(vertices->x, index_a, 4);
+        __m256 a_y = _mm256_i32gather_ps(vertices->y, index_a, 4);
+        __m256 a_z = _mm256_i32gather_ps(vertices->z, index_a, 4);
+
+        // Same steps as get_triangle_normal
+        __m256 ab_x = _mm256_sub_ps(_mm256_i32gather_ps(vertices->x, index_b, 4), a_x);
+        __m256 ab_y = _mm256_sub_ps(_mm256_i32gather_ps(vertices->y, index_b, 4), a_y);
+        __m256 ab_z = _mm256_sub_ps(_mm256_i32gather_ps(vertices->z, index_b, 4), a_z);
+        normalize_avx2(&ab_x, &ab_y, &ab_z);
+        __m256 ac_x = _mm256_sub_ps(_mm256_i32gather_ps(vertices->x, index_c, 4), a_x);
+        __m256 ac_y = _mm256_sub_ps(_mm256_i32gather_ps(vertices->y, index_c, 4), a_y);
+        __m256 ac_z = _mm256_sub_ps(_mm256_i32gather_ps(vertices->z, index_c, 4), a_z);
+        normalize_avx2(&ac_x, &ac_y, &ac_z);
+        __m256 normal_x = _mm256_sub_ps(_mm256_mul_ps(ab_y, ac_z), _mm256_mul_ps(ab_z, ac_y));
+        __m256 normal_y = _mm256_sub_ps(_mm256_mul_ps(ab_z, ac_x), _mm256_mul_ps(ab_x, ac_z));
+        __m256 normal_z = _mm256_sub_ps(_mm256_mul_ps(ab_x, ac_y), _mm256_mul_ps(ab_y, ac_x));
+        normalize_avx2(&normal_x, &normal_y, &normal_z);
+        _mm256_store_ps(&normals->x[i], normal_x);
+        _mm256_store_ps(&normals->y[i], normal_y);
+        _mm256_store_ps(&normals->z[i], normal_z);
+
+        // Alignment of the normal with the ray from a to the camera
+        __m256 alignment = _mm256_mul_ps(_mm256_sub_ps(zero, a_x), normal_x);
+        alignment = _mm256_add_ps(alignment, _mm256_mul_ps(_mm256_sub_ps(zero, a_y), normal_y));
+        alignment = _mm256_add_ps(alignment, _mm256_mul_ps(_mm256_sub_ps(zero, a_z), normal_z));
+        int front_mask = _mm256_movemask_ps(_mm256_cmp_ps(alignment, zero, _CMP_NLT_UQ));
+        for (int lane = 0; lane < VERTEX_STREAM_WIDTH; lane++) {
+            is_front_face[i + lane] = (front_mask >> lane) & 1;
+        }
+    }
+    return i;
+}
+
+static bool use_avx2(void) {
+    return get_simd_mode() == SIMD_ON && has_avx2();
+}
+
+#endif
+
+// Stream passes ==============================================================
+
+void transform_vertex_stream(const mat4_t* m, const vertex_stream_t* in, vertex_stream_t* out) {
+#ifdef HAS_AVX2_KERNELS
+    if (use_avx2()) {
+        transform_vertex_stream_avx2(m, in, out);
+        return;
+    }
+#endif
+    for (int i = 0; i < in->count; i++) {
+        transform_vertex_scalar(m, in, out, i);
+    }
+}
+
+void project_vertex_stream(
+    const mat4_t* projection, const vertex_stream_t* in, vertex_stream_t* out,
+    clip_flags_t* clip_flags, int width, int height
+) {
+    float half_width = (float)width / 2;
+    float half_height = (float)height / 2;
+#ifdef HAS_AVX2_KERNELS
+    if (use_avx2()) {
+        project_vertex_stream_avx2(projection, in, out, clip_flags, half_width, half_height);
+        return;
+    }
+#endif
+    for (int i = 0; i < in->count; i++) {
+        project_vertex_scalar(projection, in, out, clip_flags, half_width, half_height, i);
+    }
+}
+
+void compute_face_normals(
+    const face_t* faces, int num_faces, const vertex_stream_t* vertices,
+    vertex_stream_t* normals, bool* is_front_face
+) {
+    int i = 0;
+#ifdef HAS_AVX2_KERNELS
+    if (use_avx2()) {
+        i = compute_face_normals_avx2(faces, num_faces, vertices, normals, is_front_face);
+    }
+#endif
+    for (; i < num_faces; i++) {
+        compute_face_normal_scalar(faces, vertices, normals, is_front_face, i);
+    }
+}
@@ -0,0 +1,198 @@
+#include "line.h"
+#include "array.h"
+#include "display.h"
+#include "triangle.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Draw line ------------------------------------------------------------------
+
+static long long floor_div(long long numerator, long long denominator) {
+    long long quotient = numerator / denominator;
+    if ((numerator % denominator != 0) && ((numerator < 0) != (denominator < 0))) {
+        quotient--;
+    }
+    return quotient;
+}
+
+/*
+* Midpoint line: the step i along the major axis moves the minor axis by
+* floor((2 * i * minor_delta + major_delta) / (2 * major_delta)). It has a
+* closed form, so the first visible step is computed instead of walked to.
+*/
+static void draw_line_clipped(int x0, int y0, int x1, int y1, color_t color) {
+    rect_t clip = get_clip_rect();
+    bool is_x_major = abs(x1 - x0) >= abs(y1 - y0);
+    // Major axis a, minor axis b
+    long long a0 = is_x_major ? x0 : y0;
+    long long b0 = is_x_major ? y0 : x0;
+    long long a_delta = is_x_major ? x1 - x0 : y1 - y0;
+    long long b_delta = is_x_major ? y1 - y0 : x1 - x0;
+    long long a_min = is_x_major ? clip.x_min : clip.y_min;
+    long long a_max = is_x_major ? clip.x_max : clip.y_max;
+    long long b_min = is_x_major ? clip.y_min : clip.x_min;
+    long long b_max = is_x_major ? clip.y_max : clip.x_max;
+    int a_sign = a_delta < 0 ? -1 : 1;
+    int b_sign = b_delta < 0 ? -1 : 1;
+    long long major = llabs(a_delta);
+    long long minor = llabs(b_delta);
+
+    // Steps with the major axis in the clip rect
+    long long first = 0;
+    long long last = major;
+    if (a_sign > 0) {
+        first = MAX(first, a_min - a0);
+        last = MIN(last, a_max - a0);
+    } else {
+        first = MAX(first, a0 - a_max);
+        last = MIN(last, a0 - a_min);
+    }
+
+    // Steps with the minor axis offset in [offset_min, offset_max]
+    long long offset_min = b_sign > 0 ? b_min - b0 : b0 - b_max;
+    long long offset_max = b_sign > 0 ? b_max - b0 : b0 - b_min;
+    if (minor == 0) {
+        if (offset_min > 0 || offset_max < 0) return;
+    } else {
+        first = MAX(first, -floor_div(major - 2 * major * offset_min, 2 * minor));
+        last = MIN(last, floor_div(2 * major * (offset_max + 1) - major - 1, 2 * minor));
+    }
+    if (first > last) {
+        return;
+    }
+
+    // Walk the visible steps only
+    long long two_major = 2 * MAX(major, 1);
+    long long numerator = 2 * first * minor + major;
+    int a = (int)(a0 + a_sign * first);
+    int b = (int)(b0 + b_sign * (numerator / two_major));
+    long long error = numerator % two_major;
+    for (long long i = first; i <= last; i++) {
+        if (is_x_major) {
+            get_color_buffer_row(b)[a] = color;
+        } else {
+            get_color_buffer_row(a)[b] = color;
+        }
+        a += a_sign;
+        error += 2 * minor;
+        if (error >= two_major) {
+            error -= two_major;
+            b += b_sign;
+        }
+    }
+}
+
+void draw_line(vec2_t start, vec2_t end, color_t color) {
+    draw_line_clipped(start.x, start.y, end.x, end.y, color);
+}
+
+void draw_triangle(triangle_t triangle, color_t color) {
+    for (int v = 0; v < 3; v++) {
+        vec4_t* start = &triangle.points[v];
+        vec4_t* end = &triangle.points[(v + 1) % 3];
+        draw_line_clipped(start->data[0], start->data[1], end->data[0], end->data[1], color);
+    }
+}
+
+// Wireframe ------------------------------------------------------------------
+
+// Edge of the frame: pixel endpoints sorted so both triangles find the same key
+typedef struct {
+    int x0, y0, x1, y1;
+    int triangle;  // Owner, -1 for an empty slot
+    int edge;      // Index of the edge in the owner
+} wireframe_edge_t;
+
+static triangle_t* frame_triangles = NULL;
+static uint8_t* edge_masks = NULL;               // Dynamic array, owned edges of each triangle
+static wireframe_edge_t* edge_table = NULL;      // Dynamic array, open addressing
+static int edge_table_size = 0;                  // Power of two
+
+static wireframe_edge_t make_edge(const triangle_t* triangle, int edge) {
+    const vec4_t* a = &triangle->points[edge];
+    const vec4_t* b = &triangle->points[(edge + 1) % 3];
+    int ax = a->data[0], ay = a->data[1];
+    int bx = b->data[0], by = b->data[1];
+    bool is_sorted = ay < by || (ay == by && ax <= bx);
+    return (wireframe_edge_t){
+        .x0 = is_sorted ? ax : bx, .y0 = is_sorted ? ay : by,
+        .x1 = is_sorted ? bx : ax, .y1 = is_sorted ? by : ay,
+        .triangle = -1, .edge = edge
+    };
+}
+
+static uint32_t hash_edge(const wireframe_edge_t* edge) {
+    uint32_t hash = 2166136261u;
+    int values[4] = { edge->x0, edge->y0, edge->x1, edge->y1 };
+    for (int i = 0; i < 4; i++) {
+        hash = (hash ^ (uint32_t)values[i]) * 16777619u;
+    }
+    return hash ^ (hash >> 15);
+}
+
+void prepare_wireframe(triangle_t* triangles, int num_triangles) {
+    frame_triangles = triangles;
+    array_reset(edge_masks);
+    array_reset(edge_table);
+    if (num_triangles == 0) {
+        return;
+    }
+    edge_masks = array_hold(edge_masks, num_triangles, sizeof(uint8_t));
+
+    // At most half full
+    edge_table_size = 1;
+    while (edge_table_size < 6 * num_triangles) {
+        edge_table_size <<= 1;
+    }
+    edge_table = array_hold(edge_table, edge_table_size, sizeof(wireframe_edge_t));
+    for (int i = 0; i < edge_table_size; i++) {
+        edge_table[i].triangle = -1;
+    }
+
+    // In the draw order: a later triangle takes the edge over
+    for (int i = 0; i < num_triangles; i++) {
+        edge_masks[i] = 0;
+        for (int e = 0; e < 3; e++) {
+            wireframe_edge_t edge = make_edge(&triangles[i], e);
+            uint32_t slot = hash_edge(&edge) & (edge_table_size - 1);
+            while (edge_table[slot].triangle >= 0) {
+                wireframe_edge_t* other = &edge_table[slot];
+                if (other->x0 == edge.x0 && other->y0 == edge.y0 && other->x1 == edge.x1 && other->y1 == edge.y1) {
+                    break;
+                }
+                slot = (slot + 1) & (edge_table_size - 1);
+            }
+            wireframe_edge_t* owner = &edge_table[slot];
+            if (owner->triangle >= 0) {
+                edge_masks[owner->triangle] &= ~(1 << owner->edge);
+            }
+            edge.triangle = i;
+            *owner = edge;
+            edge_masks[i] |= 1 << e;
+        }
+    }
+}
+
+void draw_wireframe_triangle(triangle_t* triangle, color_t color) {
+    uint8_t mask = edge_masks[triangle - frame_triangles];
+    for (int e = 0; e < 3; e++) {
+        if (mask & (1 << e)) {
+            vec4_t* start = &triangle->points[e];
+            vec4_t* end = &triangle->points[(e + 1) % 3];
+            draw_line_clipped(start->data[0], start->data[1], end->data[0], end->data[1], color);
+        }
+    }
+}
+
+void free_wireframe(void) {
+    array_free(edge_masks);
+    array_free(edge_table);
+    edge_masks = NULL;
+    edge_table = NULL;
+    edge_table_size = 0;
+}
@@ -1,9 +1,14 @@
 #include "mesh.h"
 #include "array.h"
+#include "matrix.h"
 #include "texture.h"
 #include "upng.h"
 #include "vector.h"
+#include "vertex_stream.h"
+#include <ctype.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define MAX_MESHES 256
@@ -11,24 +16,112 @@ static mesh_t meshes[MAX_MESHES];
 static int num_meshes = 0;
 
 void load_mesh(char* obj_filename, char* png_filename, vec3_t scaling, vec3_t translation, vec3_t rotation) {
-    load_mesh_and_data_from_obj(&meshes[num_meshes], obj_filename);
-    load_mesh_png_texture(&meshes[num_meshes], png_filename);
+    mesh_t* mesh = &meshes[num_meshes];
+    load_mesh_and_data_from_obj(mesh, obj_filename);
+    int num_vertices = mesh->vertices.count;
+    int num_faces = array_length(mesh->faces);
+    mesh->camera_vertices = create_vertex_stream(num_vertices, false);
+    mesh->screen_vertices = create_vertex_stream(num_vertices, true);
+    mesh->clip_flags = malloc(sizeof(clip_flags_t) * mesh->screen_vertices.capacity);
+    mesh->face_normals = create_vertex_stream(num_faces, false);
+    mesh->is_front_face = malloc(sizeof(bool) * num_faces);
+    if (png_filename != NULL) {
+        load_mesh_png_texture(&meshes[num_meshes], png_filename);
+    }
     meshes[num_meshes].scale = scaling;
     meshes[num_meshes].translation = translation;
     meshes[num_meshes].rotation = rotation;
+    meshes[num_meshes].is_world_dirty = true;
+    meshes[num_meshes].view_version = -1;
     num_meshes++;
 }
 
+void set_mesh_scale(mesh_t* mesh, vec3_t scale) {
+    mesh->scale = scale;
+    mesh->is_world_dirty = true;
+}
+
+void set_mesh_rotation(mesh_t* mesh, vec3_t rotation) {
+    mesh->rotation = rotation;
+    mesh->is_world_dirty = true;
+}
+
+void set_mesh_translation(mesh_t* mesh, vec3_t translation) {
+    mesh->translation = translation;
+    mesh->is_world_dirty = true;
+}
+
+// MODEL SPACE -> WORLD SPACE
+static mat4_t make_world_matrix(const mesh_t* mesh) {
+    // Transformation matrices
+    mat4_t scale_matrix = mat4_make_scale(mesh->scale.x, mesh->scale.y, mesh->scale.z);
+    mat4_t translation_matrix = mat4_make_translation(mesh->translation.x, mesh->translation.y, mesh->translation.z);
+    mat4_t rotation_matrix_x = mat4_make_rotation_x(mesh->rotation.x);
+    mat4_t rotation_matrix_y = mat4_make_rotation_y(mesh->rotation.y);
+    mat4_t rotation_matrix_z = mat4_make_rotation_z(mesh->rotation.z);
+    // World matrix
+    mat4_t world_matrix = mat4_identity();
+    world_matrix = expimental__mat4_mult_fast(world_matrix, translation_matrix);
+    world_matrix = expimental__mat4_mult_fast(world_matrix, rotation_matrix_x);
+    world_matrix = expimental__mat4_mult_fast(world_matrix, rotation_matrix_y);
+    world_matrix = expimental__mat4_mult_fast(world_matrix, rotation_matrix_z);
+    world_matrix = expimental__mat4_mult_fast(world_matrix, scale_matrix);
+    return world_matrix;
+}
+
+bool update_mesh_matrices(mesh_t* mesh, mat4_t view_matrix, int view_version) {
+    if (!mesh->is_world_dirty && mesh->view_version == view_version) {
+        return false;
+    }
+    if (mesh->is_world_dirty) {
+        mesh->world_matrix = make_world_matrix(mesh);
+        mesh->is_world_dirty = false;
+    }
+    // Model space -> camera space in one matrix
+    mesh->model_view_matrix = expimental__mat4_mult_fast(view_matrix, mesh->world_matrix);
+    mesh->view_version = view_version;
+    return true;
+}
+
 void free_meshes() {
     for (int i = 0; i < num_meshes; i++) {
-        array_free(meshes[i].vertices);
+        free_vertex_stream(&meshes[i].vertices);
+        free_vertex_stream(&meshes[i].camera_vertices);
+        free_vertex_stream(&meshes[i].screen_vertices);
+        free(meshes[i].clip_flags);
+        free_vertex_stream(&meshes[i].face_normals);
+        free(meshes[i].is_front_face);
         array_free(meshes[i].faces);
-        upng_free(meshes[i].texture);
+        free_texture(meshes[i].texture);
     }
     num_meshes = 0;
 }
 
 
+/*
+* Indices of the 3 vertices of a face line: "f v v v", "f v/vt v/vt v/vt", "f v//vn ..." or "f v/vt/vn ..."
+* A missing texture index is 0
+*/
+static void parse_face(const char* line, int vertex_indices[3], int texture_indices[3]) {
+    const char* cursor = line + 2;
+    for (int i = 0; i < 3; i++) {
+        int length = 0;
+        vertex_indices[i] = 0;
+        texture_indices[i] = 0;
+        if (sscanf(cursor, " %d%n", &vertex_indices[i], &length) != 1) {
+            continue;
+        }
+        cursor += length;
+        if (*cursor == '/' && sscanf(cursor, "/%d%n", &texture_indices[i], &length) == 1) {
+            cursor += length;
+        }
+        // Skip the normal index
+        while (*cursor != '\0' && !isspace((unsigned char)*cursor)) {
+            cursor++;
+        }
+    }
+}
+
 void load_mesh_and_data_from_obj(mesh_t* mesh, char* filename) {
     FILE* file;
     file = fopen(filename, "r");
@@ -38,6 +131,7 @@ void load_mesh_and_data_from_obj(mesh_t* mesh, char* filename) {
     }
     char line[1024];
 
+    vec3_t* vertices = NULL;
     tex2_t* texcoords = NULL;
 
     while (fgets(line, 1024, file)) {
@@ -45,7 +139,7 @@ void load_mesh_and_data_from_obj(mesh_t* mesh, char* filename) {
         if (strncmp(line, "v ", 2) == 0) {
             vec3_t vertex;
             sscanf(line, "v %f %f %f", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh->vertices, vertex);
+            array_push(vertices, vertex);
         }
 
         // Texture information
@@ -60,26 +154,28 @@ void load_mesh_and_data_from_obj(mesh_t* mesh, char* filename) {
         if (strncmp(line, "f ", 2) == 0) {
             int vertex_indices[3];
             int texture_indices[3];
-            int normal_indices[3];
-            sscanf(
-                line, "f %d/%d/%d %d/%d/%d %d/%d/%d",
-                &vertex_indices[0], &texture_indices[0], &normal_indices[0], 
-                &vertex_indices[1], &texture_indices[1], &normal_indices[1], 
-                &vertex_indices[2], &texture_indices[2], &normal_indices[2]
-            ); 
+            parse_face(line, vertex_indices, texture_indices);
+            tex2_t uvs[3];
+            for (int i = 0; i < 3; i++) {
+                bool has_uv = texture_indices[i] > 0 && texture_indices[i] <= array_length(texcoords);
+                uvs[i] = has_uv ? texcoords[texture_indices[i] - 1] : (tex2_t){ 0, 0 };
+            }
             face_t face = {
                 .a = vertex_indices[0] - 1,
                 .b = vertex_indices[1] - 1,
                 .c = vertex_indices[2] - 1,
-                .a_uv = texcoords[texture_indices[0]-1],
-                .b_uv = texcoords[texture_indices[1]-1],
-                .c_uv = texcoords[texture_indices[2]-1],
+                .a_uv = uvs[0],
+                .b_uv = uvs[1],
+                .c_uv = uvs[2],
                 .color = 0xFFEEEEEE
             };
             array_push(mesh->faces, face);
         }
     }
 
+    // Parsed as an array of structures, stored as streams
+    mesh->vertices = create_vertex_stream_from_vec3(vertices, array_length(vertices));
+    array_free(vertices);
     array_free(texcoords);
 }
 
@@ -88,10 +184,12 @@ void load_mesh_png_texture(mesh_t* mesh, char* filename) {
     if (upng_image != NULL) {
         upng_decode(upng_image);
         if (upng_get_error(upng_image) == UPNG_EOK) {
-            mesh->texture = upng_image;
+            mesh->texture = create_texture_from_png(upng_image);
         } else {
             fprintf(stderr, "Error decoding PNG\n");
         }
+        // The texture has its own copy of the texels
+        upng_free(upng_image);
     } else {
         fprintf(stderr, "Error loading PNG: %s\n", filename);
     }
@@ -116,11 +214,12 @@ void load_mesh_from_obj(mesh_t* mesh, char* filename) {
         return;
     }
     char line[128];
+    vec3_t* vertices = NULL;
     while (fgets(line, sizeof(line), file)) {
         vec3_t vertex;
         if (line[0] == 'v') {
             sscanf(line, "v %f %f %f\n", &vertex.x, &vertex.y, &vertex.z);
-            array_push(mesh->vertices, vertex);
+            array_push(vertices, vertex);
         } else if (line[0] == 'f') {
             face_t face;
             sscanf(line, "f %d %d %d\n", &face.a, &face.b, &face.c);
@@ -134,6 +233,7 @@ void load_mesh_from_obj(mesh_t* mesh, char* filename) {
         }
     }
     fclose(file);
-
+    mesh->vertices = create_vertex_stream_from_vec3(vertices, array_length(vertices));
+    array_free(vertices);
 }
 
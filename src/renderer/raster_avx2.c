@@ -0,0 +1,320 @@
+#include "raster.h"
+#include "display.h"
+#include "texture.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+* AVX2 raster kernels
+* -------------------
+* Evaluate the edge functions, 1/w and u/w v/w planes for 8 pixels of a row, then
+* do a masked depth test and a masked store. Same operations in the same
+* order as the scalar loops of triangle.c: the output is bit for bit equal.
+*
+* Compiled with a target attribute so the rest of the engine keeps running
+* on hosts without AVX2 (raster_has_avx2() is checked before every call).
+*/
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAS_AVX2_KERNELS 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#ifdef HAS_AVX2_KERNELS
+
+bool raster_has_avx2(void) {
+    static int has_avx2 = -1;
+    if (has_avx2 < 0) {
+        __builtin_cpu_init();
+        has_avx2 = __builtin_cpu_supports("avx2");
+    }
+    return has_avx2;
+}
+
+// Lanes inside the triangle (top-left rule) and before the end of the row
+AVX2_TARGET static inline __m256i coverage_mask(const __m256i w[3], const __m256i threshold[3], __m256i x, __m256i x_max) {
+    __m256i mask = _mm256_cmpgt_epi32(w[0], threshold[0]);
+    mask = _mm256_and_si256(mask, _mm256_cmpgt_epi32(w[1], threshold[1]));
+    mask = _mm256_and_si256(mask, _mm256_cmpgt_epi32(w[2], threshold[2]));
+    return _mm256_andnot_si256(_mm256_cmpgt_epi32(x, x_max), mask);
+}
+
+// Same as shade_color(): scale each channel and keep the alpha
+AVX2_TARGET static inline __m256i shade_colors(__m256i colors, __m256 factor) {
+    __m256i alpha = _mm256_and_si256(colors, _mm256_set1_epi32(0xFF000000));
+    __m256i result = alpha;
+    const int channel_masks[3] = { 0x00FF0000, 0x0000FF00, 0x000000FF };
+    for (int c = 0; c < 3; c++) {
+        __m256i mask = _mm256_set1_epi32(channel_masks[c]);
+        __m256 channel = _mm256_cvtepi32_ps(_mm256_and_si256(colors, mask));
+        __m256i shaded = _mm256_cvttps_epi32(_mm256_mul_ps(channel, factor));
+        result = _mm256_or_si256(result, _mm256_and_si256(shaded, mask));
+    }
+    return result;
+}
+
+// Same as texture_offset(): wrap with a mask, then index the 4x4 blocks
+AVX2_TARGET static inline __m256i texture_offsets(const texture_level_t* texture, __m256i tex_x, __m256i tex_y) {
+    tex_x = _mm256_and_si256(tex_x, _mm256_set1_epi32(texture->width - 1));
+    tex_y = _mm256_and_si256(tex_y, _mm256_set1_epi32(texture->height - 1));
+    const __m256i inside_mask = _mm256_set1_epi32(TEXTURE_BLOCK_SIZE - 1);
+    __m256i block_row = _mm256_sll_epi32(
+        _mm256_srli_epi32(tex_y, TEXTURE_BLOCK_BITS),
+        _mm_cvtsi32_si128(texture->width_shift - TEXTURE_BLOCK_BITS));
+    __m256i block = _mm256_add_epi32(block_row, _mm256_srli_epi32(tex_x, TEXTURE_BLOCK_BITS));
+    __m256i inside = _mm256_or_si256(
+        _mm256_slli_epi32(_mm256_and_si256(tex_y, inside_mask), TEXTURE_BLOCK_BITS),
+        _mm256_and_si256(tex_x, inside_mask));
+    return _mm256_or_si256(_mm256_slli_epi32(block, 2 * TEXTURE_BLOCK_BITS), inside);
+}
+
+// Same as texture_lerp(): two channels per 32-bit lane, 16 bits each
+AVX2_TARGET static inline __m256i lerp_texels(__m256i a, __m256i b, __m256i weight) {
+    const __m256i channels = _mm256_set1_epi32(0x00FF00FF);
+    // Weights in both 16-bit halves of the lane
+    __m256i weight_b = _mm256_or_si256(weight, _mm256_slli_epi32(weight, 16));
+    __m256i weight_a = _mm256_sub_epi16(_mm256_set1_epi16(256), weight_b);
+    __m256i red_blue = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_and_si256(a, channels), weight_a),
+        _mm256_mullo_epi16(_mm256_and_si256(b, channels), weight_b));
+    __m256i alpha_green = _mm256_add_epi16(
+        _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(a, 8), channels), weight_a),
+        _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(b, 8), channels), weight_b));
+    return _mm256_or_si256(_mm256_srli_epi16(red_blue, 8), _mm256_and_si256(alpha_green, _mm256_set1_epi32(0xFF00FF00)));
+}
+
+AVX2_TARGET static inline __m256i gather_texels(const texture_level_t* texture, __m256i tex_x, __m256i tex_y, __m256i mask) {
+    __m256i index = texture_offsets(texture, tex_x, tex_y);
+    return _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int*)texture->texels, index, mask, 4);
+}
+
+// Same as texture_sample_bilinear(): 4 gathers blended in 16-bit lanes
+AVX2_TARGET static inline __m256i sample_bilinear(const texture_level_t* texture, __m256 u, __m256 v, __m256i mask) {
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 weight_scale = _mm256_set1_ps(256.0f);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256 texel_u = _mm256_sub_ps(_mm256_mul_ps(u, _mm256_set1_ps((float)texture->width)), half);
+    __m256 texel_v = _mm256_sub_ps(_mm256_mul_ps(v, _mm256_set1_ps((float)texture->height)), half);
+    __m256 x = _mm256_floor_ps(texel_u);
+    __m256 y = _mm256_floor_ps(texel_v);
+    __m256i weight_x = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(texel_u, x), weight_scale));
+    __m256i weight_y = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_sub_ps(texel_v, y), weight_scale));
+    __m256i x0 = _mm256_cvttps_epi32(x);
+    __m256i y0 = _mm256_cvttps_epi32(y);
+    __m256i x1 = _mm256_add_epi32(x0, one);
+    __m256i y1 = _mm256_add_epi32(y0, one);
+
+    __m256i top = lerp_texels(gather_texels(texture, x0, y0, mask), gather_texels(texture, x1, y0, mask), weight_x);
+    __m256i bottom = lerp_texels(gather_texels(texture, x0, y1, mask), gather_texels(texture, x1, y1, mask), weight_x);
+    return lerp_texels(top, bottom, weight_y);
+}
+
+// Same as encode_unorm_depth()
+AVX2_TARGET static inline __m256i encode_unorm_depths(__m256 reciprocal_w, const depth_range_t* range, float max) {
+    __m256 depth = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(range->near_inverse), reciprocal_w), _mm256_set1_ps(range->scale));
+    depth = _mm256_max_ps(depth, _mm256_setzero_ps());
+    depth = _mm256_min_ps(depth, _mm256_set1_ps(1.0f));
+    __m256i value = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(depth, _mm256_set1_ps(max)), _mm256_set1_ps(0.5f)));
+    return _mm256_min_epi32(value, _mm256_set1_epi32((int)max - 1));
+}
+
+/*
+* Same as depth_test() for the 32 bits formats: return the lanes of mask that
+* pass, their depth is already written
+*/
+AVX2_TARGET static inline __m256i depth_test_avx2(void* z_row, int x, __m256i mask, __m256 reciprocal_w, const depth_range_t* range, int format) {
+    __m256i pass;
+    if (format == DEPTH_UNORM24) {
+        int* z = (int*)z_row + x;
+        __m256i depth = encode_unorm_depths(reciprocal_w, range, DEPTH_UNORM24_MAX);
+        pass = _mm256_and_si256(mask, _mm256_cmpgt_epi32(_mm256_maskload_epi32(z, mask), depth));
+        _mm256_maskstore_epi32(z, pass, depth);
+    } else if (format == DEPTH_REVERSED_FLOAT) {
+        float* z = (float*)z_row + x;
+        __m256 depth = reciprocal_w;
+        pass = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(depth, _mm256_maskload_ps(z, mask), _CMP_GT_OQ)));
+        _mm256_maskstore_ps(z, pass, depth);
+    } else {
+        float* z = (float*)z_row + x;
+        __m256 depth = _mm256_sub_ps(_mm256_set1_ps(1.0f), reciprocal_w);
+        pass = _mm256_and_si256(mask, _mm256_castps_si256(_mm256_cmp_ps(depth, _mm256_maskload_ps(z, mask), _CMP_LT_OQ)));
+        _mm256_maskstore_ps(z, pass, depth);
+    }
+    return pass;
+}
+
+// Depth test a constant value: the flat color or the triangle index of the visibility buffer
+AVX2_TARGET static void raster_constant_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, uint32_t value, bool is_id,
+    const depth_range_t* depth_range, int depth_format
+) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i x_max = _mm256_set1_epi32(setup->x_max);
+    const __m256i value_v = _mm256_set1_epi32(value);
+    const __m256 inverse_w_dx = _mm256_set1_ps(inverse_w->dx);
+    __m256i threshold[3], block_step[3];
+    for (int i = 0; i < 3; i++) {
+        threshold[i] = _mm256_set1_epi32(setup->threshold[i] - 1);
+        block_step[i] = _mm256_set1_epi32(setup->step_x[i] * 8);
+    }
+
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        uint32_t* value_row = is_id ? get_id_buffer_row(y) : get_color_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        const __m256 inverse_w_row = _mm256_set1_ps(attribute_plane_row(inverse_w, y - setup->y_anchor));
+        __m256i w[3];
+        for (int i = 0; i < 3; i++) {
+            w[i] = _mm256_add_epi32(_mm256_set1_epi32(w_row[i]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(setup->step_x[i])));
+        }
+
+        for (int x = setup->x_min; x <= setup->x_max; x += 8) {
+            __m256i mask = coverage_mask(w, threshold, _mm256_add_epi32(_mm256_set1_epi32(x), lanes), x_max);
+            if (!_mm256_testz_si256(mask, mask)) {
+                __m256 offset_x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x - setup->x_anchor), lanes));
+                __m256 reciprocal_w = _mm256_add_ps(inverse_w_row, _mm256_mul_ps(inverse_w_dx, offset_x));
+                __m256i pass = depth_test_avx2(z_row, x, mask, reciprocal_w, depth_range, depth_format);
+                _mm256_maskstore_epi32((int*)&value_row[x], pass, value_v);
+            }
+            for (int i = 0; i < 3; i++) {
+                w[i] = _mm256_add_epi32(w[i], block_step[i]);
+            }
+        }
+
+        for (int i = 0; i < 3; i++) {
+            w_row[i] += setup->step_y[i];
+        }
+    }
+}
+
+AVX2_TARGET void raster_flat_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, color_t color,
+    const depth_range_t* depth_range, int depth_format
+) {
+    raster_constant_avx2(setup, inverse_w, color, false, depth_range, depth_format);
+}
+
+AVX2_TARGET void raster_visibility_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, uint32_t id,
+    const depth_range_t* depth_range, int depth_format
+) {
+    raster_constant_avx2(setup, inverse_w, id, true, depth_range, depth_format);
+}
+
+AVX2_TARGET void raster_textured_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w,
+    const attribute_plane_t* u_w, const attribute_plane_t* v_w,
+    const texture_level_t* texture, bool is_bilinear, float light_intensity,
+    const depth_range_t* depth_range, int depth_format
+) {
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i x_max = _mm256_set1_epi32(setup->x_max);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 inverse_w_dx = _mm256_set1_ps(inverse_w->dx);
+    const __m256 u_w_dx = _mm256_set1_ps(u_w->dx);
+    const __m256 v_w_dx = _mm256_set1_ps(v_w->dx);
+    const __m256 width_f = _mm256_set1_ps((float)texture->width);
+    const __m256 height_f = _mm256_set1_ps((float)texture->height);
+    // Same clamp as shade_color()
+    float factor = light_intensity < 0 ? 0 : (light_intensity > 1 ? 1 : light_intensity);
+    const __m256 factor_v = _mm256_set1_ps(factor);
+
+    __m256i threshold[3], block_step[3];
+    for (int i = 0; i < 3; i++) {
+        threshold[i] = _mm256_set1_epi32(setup->threshold[i] - 1);
+        block_step[i] = _mm256_set1_epi32(setup->step_x[i] * 8);
+    }
+
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        const __m256 inverse_w_row = _mm256_set1_ps(attribute_plane_row(inverse_w, y - setup->y_anchor));
+        const __m256 u_w_row = _mm256_set1_ps(attribute_plane_row(u_w, y - setup->y_anchor));
+        const __m256 v_w_row = _mm256_set1_ps(attribute_plane_row(v_w, y - setup->y_anchor));
+        __m256i w[3];
+        for (int i = 0; i < 3; i++) {
+            w[i] = _mm256_add_epi32(_mm256_set1_epi32(w_row[i]), _mm256_mullo_epi32(lanes, _mm256_set1_epi32(setup->step_x[i])));
+        }
+
+        for (int x = setup->x_min; x <= setup->x_max; x += 8) {
+            __m256i mask = coverage_mask(w, threshold, _mm256_add_epi32(_mm256_set1_epi32(x), lanes), x_max);
+            if (!_mm256_testz_si256(mask, mask)) {
+                __m256 offset_x = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(x - setup->x_anchor), lanes));
+                __m256 reciprocal_w = _mm256_add_ps(inverse_w_row, _mm256_mul_ps(inverse_w_dx, offset_x));
+                __m256i pass = depth_test_avx2(z_row, x, mask, reciprocal_w, depth_range, depth_format);
+                if (!_mm256_testz_si256(pass, pass)) {
+                    __m256 w_v = _mm256_div_ps(one, reciprocal_w);
+                    __m256 u = _mm256_mul_ps(_mm256_add_ps(u_w_row, _mm256_mul_ps(u_w_dx, offset_x)), w_v);
+                    __m256 v = _mm256_mul_ps(_mm256_add_ps(v_w_row, _mm256_mul_ps(v_w_dx, offset_x)), w_v);
+
+                    __m256i texels;
+                    if (is_bilinear) {
+                        texels = sample_bilinear(texture, u, v, pass);
+                    } else {
+                        __m256i tex_x = _mm256_cvttps_epi32(_mm256_mul_ps(u, width_f));
+                        __m256i tex_y = _mm256_cvttps_epi32(_mm256_mul_ps(v, height_f));
+                        texels = gather_texels(texture, tex_x, tex_y, pass);
+                    }
+
+                    _mm256_maskstore_epi32((int*)&color_row[x], pass, shade_colors(texels, factor_v));
+                }
+            }
+            for (int i = 0; i < 3; i++) {
+                w[i] = _mm256_add_epi32(w[i], block_step[i]);
+            }
+        }
+
+        for (int i = 0; i < 3; i++) {
+            w_row[i] += setup->step_y[i];
+        }
+    }
+}
+
+#else
+
+// No AVX2 kernels on this architecture: the scalar loops are always used
+bool raster_has_avx2(void) {
+    return false;
+}
+
+void raster_flat_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, color_t color,
+    const depth_range_t* depth_range, int depth_format
+) {
+    (void)setup;
+    (void)inverse_w;
+    (void)color;
+    (void)depth_range;
+    (void)depth_format;
+}
+
+void raster_visibility_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w, uint32_t id,
+    const depth_range_t* depth_range, int depth_format
+) {
+    (void)setup;
+    (void)inverse_w;
+    (void)id;
+    (void)depth_range;
+    (void)depth_format;
+}
+
+void raster_textured_avx2(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w,
+    const attribute_plane_t* u_w, const attribute_plane_t* v_w,
+    const texture_level_t* texture, bool is_bilinear, float light_intensity,
+    const depth_range_t* depth_range, int depth_format
+) {
+    (void)setup;
+    (void)inverse_w;
+    (void)u_w;
+    (void)v_w;
+    (void)texture;
+    (void)is_bilinear;
+    (void)light_intensity;
+    (void)depth_range;
+    (void)depth_format;
+}
+
+#endif // HAS_AVX2_KERNELS
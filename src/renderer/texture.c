@@ -1,6 +1,116 @@
 #include "texture.h"
+#include "upng.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 
 tex2_t tex2_clone(tex2_t* tex) {
     return (tex2_t) {tex->u, tex->v};
 }
 
+static int next_power_of_two(int value) {
+    int power = TEXTURE_BLOCK_SIZE;
+    while (power < value) {
+        power <<= 1;
+    }
+    return power;
+}
+
+static int log2_int(int power_of_two) {
+    int shift = 0;
+    while ((1 << shift) < power_of_two) {
+        shift++;
+    }
+    return shift;
+}
+
+static void allocate_level(texture_level_t* level, int width, int height) {
+    level->width = width;
+    level->height = height;
+    level->width_shift = log2_int(width);
+    level->texels = (uint32_t*)malloc(sizeof(uint32_t) * width * height);
+}
+
+// Texel of the png packed as a color_t (0xAARRGGBB)
+static uint32_t png_texel(const unsigned char* buffer, upng_format format, int index) {
+    if (format == UPNG_RGB8) {
+        const unsigned char* rgb = &buffer[index * 3];
+        return 0xFF000000 | ((uint32_t)rgb[0] << 16) | ((uint32_t)rgb[1] << 8) | rgb[2];
+    }
+    const unsigned char* rgba = &buffer[index * 4];
+    return ((uint32_t)rgba[3] << 24) | ((uint32_t)rgba[0] << 16) | ((uint32_t)rgba[1] << 8) | rgba[2];
+}
+
+// Average of the 2x2 texels of the previous level, channel per channel
+static void build_level(const texture_level_t* source, texture_level_t* level) {
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < level->height; y++) {
+        for (int x = 0; x < level->width; x++) {
+            uint32_t texels[4] = {
+                texture_fetch(source, 2 * x, 2 * y),
+                texture_fetch(source, 2 * x + 1, 2 * y),
+                texture_fetch(source, 2 * x, 2 * y + 1),
+                texture_fetch(source, 2 * x + 1, 2 * y + 1)
+            };
+            uint32_t average = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                uint32_t sum = 2;  // Round to nearest
+                for (int i = 0; i < 4; i++) {
+                    sum += (texels[i] >> shift) & 0xFF;
+                }
+                average |= (sum / 4) << shift;
+            }
+            level->texels[texture_offset(level, x, y)] = average;
+        }
+    }
+}
+
+texture_t* create_texture_from_png(upng_t* png_image) {
+    upng_format format = upng_get_format(png_image);
+    if (format != UPNG_RGBA8 && format != UPNG_RGB8) {
+        fprintf(stderr, "Error texture format not supported (RGB8 or RGBA8 only)\n");
+        return NULL;
+    }
+    int png_width = upng_get_width(png_image);
+    int png_height = upng_get_height(png_image);
+    const unsigned char* png_buffer = upng_get_buffer(png_image);
+
+    texture_t* texture = (texture_t*)malloc(sizeof(texture_t));
+    texture_level_t* base = &texture->levels[0];
+    allocate_level(base, next_power_of_two(png_width), next_power_of_two(png_height));
+
+    // Nearest resampling up to the power of two size (a no-op for the usual 256x256)
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < base->height; y++) {
+        int png_y = (int)((long long)y * png_height / base->height);
+        for (int x = 0; x < base->width; x++) {
+            int png_x = (int)((long long)x * png_width / base->width);
+            base->texels[texture_offset(base, x, y)] = png_texel(png_buffer, format, png_y * png_width + png_x);
+        }
+    }
+
+    // Mipmaps: halve both sizes while they stay at least one block
+    texture->num_levels = 1;
+    while (texture->num_levels < TEXTURE_MAX_LEVELS) {
+        const texture_level_t* source = &texture->levels[texture->num_levels - 1];
+        if (source->width < 2 * TEXTURE_BLOCK_SIZE || source->height < 2 * TEXTURE_BLOCK_SIZE) {
+            break;
+        }
+        texture_level_t* level = &texture->levels[texture->num_levels];
+        allocate_level(level, source->width / 2, source->height / 2);
+        build_level(source, level);
+        texture->num_levels++;
+    }
+
+    return texture;
+}
+
+void free_texture(texture_t* texture) {
+    if (texture == NULL) {
+        return;
+    }
+    for (int i = 0; i < texture->num_levels; i++) {
+        free(texture->levels[i].texels);
+    }
+    free(texture);
+}
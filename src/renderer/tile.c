@@ -0,0 +1,104 @@
+#include "tile.h"
+#include "array.h"
+#include "display.h"
+#include "profiler.h"
+#include "triangle.h"
+#include <stdlib.h>
+
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
+// Bins of the current frame: dynamic array of triangle index per tile
+static int** tile_bins = NULL;
+static int num_tiles_x = 0;
+static int num_tiles_y = 0;
+
+static void initialize_tiles(void) {
+    int tiles_x = (get_window_width() + TILE_SIZE - 1) / TILE_SIZE;
+    int tiles_y = (get_window_height() + TILE_SIZE - 1) / TILE_SIZE;
+    if (tile_bins != NULL && tiles_x == num_tiles_x && tiles_y == num_tiles_y) {
+        return;
+    }
+    free_tiles();
+    num_tiles_x = tiles_x;
+    num_tiles_y = tiles_y;
+    tile_bins = (int**)calloc(num_tiles_x * num_tiles_y, sizeof(int*));
+}
+
+void free_tiles(void) {
+    if (tile_bins == NULL) {
+        return;
+    }
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++) {
+        array_free(tile_bins[i]);
+    }
+    free(tile_bins);
+    tile_bins = NULL;
+    num_tiles_x = 0;
+    num_tiles_y = 0;
+}
+
+static void bin_triangles(triangle_t* triangles, int num_triangles, int margin) {
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++) {
+        array_reset(tile_bins[i]);
+    }
+
+    for (int i = 0; i < num_triangles; i++) {
+        vec4_t* points = triangles[i].points;
+        int x_min = MIN(points[0].data[0], MIN(points[1].data[0], points[2].data[0]));
+        int y_min = MIN(points[0].data[1], MIN(points[1].data[1], points[2].data[1]));
+        int x_max = MAX(points[0].data[0], MAX(points[1].data[0], points[2].data[0])) + margin;
+        int y_max = MAX(points[0].data[1], MAX(points[1].data[1], points[2].data[1])) + margin;
+
+        // Tiles overlapped by the bounding box
+        int tile_x_min = MAX(x_min / TILE_SIZE, 0);
+        int tile_y_min = MAX(y_min / TILE_SIZE, 0);
+        int tile_x_max = MIN(x_max / TILE_SIZE, num_tiles_x - 1);
+        int tile_y_max = MIN(y_max / TILE_SIZE, num_tiles_y - 1);
+
+        for (int tile_y = tile_y_min; tile_y <= tile_y_max; tile_y++) {
+            for (int tile_x = tile_x_min; tile_x <= tile_x_max; tile_x++) {
+                array_push(tile_bins[tile_y * num_tiles_x + tile_x], i);
+            }
+        }
+    }
+}
+
+void render_tiles(triangle_t* triangles, int num_triangles, int margin, tile_draw_fn draw, color_t clear_color, const raster_settings_t* settings) {
+    PROFILE_BEGIN(STAGE_BINNING);
+    initialize_tiles();
+    bin_triangles(triangles, num_triangles, margin);
+    PROFILE_END(STAGE_BINNING);
+
+    // Tiles do not have the same cost: hand them out one at a time
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int tile = 0; tile < num_tiles_x * num_tiles_y; tile++) {
+        int* bin = tile_bins[tile];
+        int num_binned = array_length(bin);
+        int tile_x = (tile % num_tiles_x) * TILE_SIZE;
+        int tile_y = (tile / num_tiles_x) * TILE_SIZE;
+        rect_t tile_rect = {
+            .x_min = tile_x,
+            .y_min = tile_y,
+            .x_max = MIN(tile_x + TILE_SIZE, get_window_width()) - 1,
+            .y_max = MIN(tile_y + TILE_SIZE, get_window_height()) - 1
+        };
+        PROFILE_BEGIN(STAGE_CLEAR);
+        if (num_binned == 0) {
+            stream_clear_rect(tile_rect, clear_color, settings->depth_format);
+            PROFILE_END(STAGE_CLEAR);
+            continue;
+        }
+
+        // First touch of the tile in the frame
+        clear_rect(tile_rect, clear_color, settings->depth_format);
+        PROFILE_END(STAGE_CLEAR);
+        PROFILE_BEGIN(STAGE_RASTER);
+        set_clip_rect(tile_rect);
+        for (int i = 0; i < num_binned; i++) {
+            draw(&triangles[bin[i]], settings);
+        }
+        reset_clip_rect();
+        PROFILE_END(STAGE_RASTER);
+    }
+}
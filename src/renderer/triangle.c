@@ -1,12 +1,17 @@
 #include "triangle.h"
 #include "display.h"
 #include "light.h"
+#include "raster.h"
 #include "texture.h"
-#include "upng.h"
 #include "vector.h"
+#include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
+#define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
+
 vec3_t get_triangle_normal(vec4_t vertices[3]) {
     // Utils for Back culling and light shading       /*     A     */
     vec3_t vector_a = vec3_from_vec4(vertices[0]);    /*    / \    */
@@ -26,280 +31,464 @@ vec3_t get_triangle_normal(vec4_t vertices[3]) {
     return normal;
 }
 
-// Helper function ============================================================
-void point_swap(vec4_t* point_a, vec4_t* point_b) {
-    vec4_t tmp = *point_a;
-    *point_a = *point_b;
-    *point_b = tmp;
+// Rasterizer setup ==========================================================
+
+/*
+*  How to know if the point P is inside the triangle ?
+*
+*   V_0
+*   |\
+*   | \
+*   |  \
+*   |   \
+*   | .  \
+*   |  P  \
+*   |______\
+*   V_2     V_1
+*
+*   Check if P is to the "right" or the "left" the edges
+*   - Using cross product to find the magnitude of the z component (coming out of the screen)
+*   - `cross2d = ax * by - bx * ay`
+*   - if the arrow point "inside" the triangle, the sign is +
+*
+*   PERF: Edge function and constant increment so each pixel only costs 3 adds
+*   See: https://www.cs.drexel.edu/~deb39/Classes/Papers/comp175-06-pineda.pdf
+*/
+typedef struct {
+    int x, y;
+} vec2i_t;
+
+static int edge_cross(vec2i_t a, vec2i_t b, vec2i_t p) {
+    vec2i_t ab = { b.x - a.x, b.y - a.y };
+    vec2i_t ap = { p.x - a.x, p.y - a.y };
+    return ab.x * ap.y - ab.y * ap.x;
 }
 
-void tex2_swap(tex2_t* point_a, tex2_t* point_b) {
-    tex2_t tmp = *point_a;
-    *point_a = *point_b;
-    *point_b = tmp;
+static bool is_top_left(vec2i_t start, vec2i_t end) {
+    vec2i_t edge = { end.x - start.x, end.y - start.y };
+    bool is_top_edge = edge.y == 0 && edge.x > 0;
+    bool is_left_edge = edge.y < 0;
+    return is_top_edge || is_left_edge;
 }
 
-void int_swap(int* a, int* b) {
-    int tmp = *a;
-    *a = *b;
-    *b = tmp;
+static int floor_div(int a, int b) {
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
 }
 
-void order_triangle_by_y(triangle_t* triangle) {
-    if (triangle->points[0].data[1] > triangle->points[1].data[1]) {
-        point_swap(&triangle->points[0], &triangle->points[1]);
-        tex2_swap(&triangle->tex_coords[0], &triangle->tex_coords[1]);
+/*
+* Subpixel precision: vertices snapped to 28.4 fixed point, pixels sampled at
+* their center. The edge functions stay exact integers (watertight meshes) as
+* long as they fit in 32 bits: 2 * (16 * width) * (16 * height) < 2^31, so
+* triangles with a bounding box over 2^22 pixels use whole pixel positions.
+*/
+#define SUBPIXEL_BITS 4
+#define SUBPIXEL_SCALE (1 << SUBPIXEL_BITS)
+#define MAX_SUBPIXEL_BOX_AREA (1LL << 30)
+
+static void snap_vertices(const triangle_t* triangle, vec2i_t v[3], int scale) {
+    for (int i = 0; i < 3; i++) {
+        v[i].x = scale == 1 ? (int)triangle->points[i].data[0] : (int)lroundf(triangle->points[i].data[0] * scale);
+        v[i].y = scale == 1 ? (int)triangle->points[i].data[1] : (int)lroundf(triangle->points[i].data[1] * scale);
     }
-    if (triangle->points[1].data[1] > triangle->points[2].data[1]) {
-        point_swap(&triangle->points[1], &triangle->points[2]);
-        tex2_swap(&triangle->tex_coords[1], &triangle->tex_coords[2]);
+}
+
+bool setup_triangle(const triangle_t* triangle, raster_setup_t* setup, const raster_settings_t* settings) {
+    vec2i_t v[3];
+    int order[3] = { 0, 1, 2 };
+    // Position of the sample of a pixel: x * scale + half
+    int scale = 1;
+    int half = 0;
+    if (settings->subpixel_mode == SUBPIXEL_ON) {
+        snap_vertices(triangle, v, SUBPIXEL_SCALE);
+        long long box_width = MAX(v[0].x, MAX(v[1].x, v[2].x)) - MIN(v[0].x, MIN(v[1].x, v[2].x));
+        long long box_height = MAX(v[0].y, MAX(v[1].y, v[2].y)) - MIN(v[0].y, MIN(v[1].y, v[2].y));
+        if (box_width * box_height < MAX_SUBPIXEL_BOX_AREA) {
+            scale = SUBPIXEL_SCALE;
+            half = SUBPIXEL_SCALE / 2;
+        }
     }
-    if (triangle->points[0].data[1] > triangle->points[1].data[1]) {
-        point_swap(&triangle->points[0], &triangle->points[1]);
-        tex2_swap(&triangle->tex_coords[0], &triangle->tex_coords[1]);
+    if (scale == 1) {
+        snap_vertices(triangle, v, 1);
     }
-}
 
-vec3_t barycentric_weights(vec2_t a, vec2_t b, vec2_t c, vec2_t p) {
-    vec2_t ac = vec2_sub(c, a);
-    vec2_t ab = vec2_sub(b, a);
-    vec2_t ap = vec2_sub(p, a);
-    vec2_t pc = vec2_sub(c, p);
-    vec2_t pb = vec2_sub(b, p);
+    int area = edge_cross(v[0], v[1], v[2]);
+    if (area == 0) {
+        return false;
+    }
+    // Culling can be turned off: always walk the edges with a positive area
+    if (area < 0) {
+        vec2i_t tmp = v[1];
+        v[1] = v[2];
+        v[2] = tmp;
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
 
-    float area_parallelogram_abc = (ac.x * ab.y - ac.y * ab.x); // || AC x AB ||
-    if (area_parallelogram_abc == 0) {
-        return (vec3_t){0, 0, 0};
+    // Find a bounding box with all the candidate pixels (pixels with their sample inside)
+    rect_t clip = get_clip_rect();
+    setup->x_min = MAX(-floor_div(half - MIN(v[0].x, MIN(v[1].x, v[2].x)), scale), clip.x_min);
+    setup->y_min = MAX(-floor_div(half - MIN(v[0].y, MIN(v[1].y, v[2].y)), scale), clip.y_min);
+    setup->x_max = MIN(floor_div(MAX(v[0].x, MAX(v[1].x, v[2].x)) - half, scale), clip.x_max);
+    setup->y_max = MIN(floor_div(MAX(v[0].y, MAX(v[1].y, v[2].y)) - half, scale), clip.y_max);
+    if (setup->x_min > setup->x_max || setup->y_min > setup->y_max) {
+        return false;
     }
 
-    // Barycentric weights
-    float alpha = (pc.x * pb.y - pc.y * pb.x) / area_parallelogram_abc;
-    float beta = (ac.x * ap.y - ac.y * ap.x) / area_parallelogram_abc;
-    float gamma = 1 - alpha - beta;
+    // Edge i is the one facing the vertex i
+    vec2i_t p = { setup->x_min * scale + half, setup->y_min * scale + half };
+    for (int i = 0; i < 3; i++) {
+        vec2i_t start = v[(i + 1) % 3];
+        vec2i_t end = v[(i + 2) % 3];
+        setup->w_row[i] = edge_cross(start, end, p);
+        setup->step_x[i] = (start.y - end.y) * scale;
+        setup->step_y[i] = (end.x - start.x) * scale;
+        // Top-Left Rasterization Rule
+        setup->threshold[i] = is_top_left(start, end) ? 0 : 1;
+        setup->vertex_order[i] = order[i];
+    }
+    setup->area = area;
+
+    // Anchor of the attribute planes: independent of the clip rect
+    setup->x_anchor = floor_div(v[0].x, scale);
+    setup->y_anchor = floor_div(v[0].y, scale);
+    vec2i_t anchor = { setup->x_anchor * scale + half, setup->y_anchor * scale + half };
+    for (int i = 0; i < 3; i++) {
+        setup->w_anchor[i] = edge_cross(v[(i + 1) % 3], v[(i + 2) % 3], anchor);
+    }
 
-    vec3_t weights = { alpha, beta, gamma };
-    return weights;
+    return true;
 }
 
-// Draw =======================================================================
-
-void draw_triangle_pixel(int x, int y, vec4_t point_a, vec4_t point_b, vec4_t point_c, color_t* color, vec3_t inverse_w, float light_intensity) {
-    vec2_t point_p = { x, y };
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
-
-    vec3_t weights = barycentric_weights(a, b, c, point_p);
+attribute_plane_t setup_attribute_plane(const raster_setup_t* setup, const float values[3]) {
+    // Barycentric weight i = edge function i / area, so the plane is the weighted sum of the edges
+    double origin = 0;
+    double dx = 0;
+    double dy = 0;
+    for (int i = 0; i < 3; i++) {
+        origin += (double)values[i] * setup->w_anchor[i];
+        dx += (double)values[i] * setup->step_x[i];
+        dy += (double)values[i] * setup->step_y[i];
+    }
+    attribute_plane_t plane = {
+        .origin = origin / setup->area,
+        .dx = dx / setup->area,
+        .dy = dy / setup->area
+    };
+    return plane;
+}
 
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
+const texture_level_t* select_texture_level(const triangle_t* triangle, const raster_settings_t* settings) {
+    const texture_t* texture = triangle->texture;
+    if (settings->mipmap_mode == MIPMAP_OFF || texture->num_levels == 1) {
+        return &texture->levels[0];
+    }
 
-    // Perform the interpolation of the reciprocal w to find the depth value
-    float interpolated_reciprocal_w = inverse_w.x * alpha + inverse_w.y * beta + inverse_w.z * gamma;
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
+    // Texels per pixel over the whole triangle: ratio of the uv and screen areas
+    const float* p0 = triangle->points[0].data;
+    const float* p1 = triangle->points[1].data;
+    const float* p2 = triangle->points[2].data;
+    const tex2_t* uv = triangle->tex_coords;
+    float screen_area = fabsf((p1[0] - p0[0]) * (p2[1] - p0[1]) - (p2[0] - p0[0]) * (p1[1] - p0[1]));
+    float uv_area = fabsf((uv[1].u - uv[0].u) * (uv[2].v - uv[0].v) - (uv[2].u - uv[0].u) * (uv[1].v - uv[0].v));
+    float texel_area = uv_area * texture->levels[0].width * texture->levels[0].height;
+    if (screen_area <= 0 || texel_area <= 0) {
+        return &texture->levels[0];
+    }
 
-    if (interpolated_reciprocal_w < get_z_buffer(x, y)) {
-        // Draw the pixel with the color from the texture
-        draw_pixel(x, y, shade_color(*color, light_intensity));
-        // Update the z_buffer for the current pixel
-        update_z_buffer(x, y, interpolated_reciprocal_w);
+    // Under perspective the ratio at vertex i is ratio * w_i^2 / (w_j * w_k): keep the smallest
+    float min_scale = INFINITY;
+    for (int i = 0; i < 3; i++) {
+        float w_i = triangle->points[i].data[3];
+        float w_j = triangle->points[(i + 1) % 3].data[3];
+        float w_k = triangle->points[(i + 2) % 3].data[3];
+        min_scale = MIN(min_scale, w_i * w_i / (w_j * w_k));
     }
+    float texels_per_pixel = texel_area / screen_area * min_scale;
+
+    // Each level divides the texel area by 4
+    int level = (int)floorf(0.5f * log2f(texels_per_pixel));
+    level = MAX(0, MIN(level, texture->num_levels - 1));
+    return &texture->levels[level];
 }
 
-void draw_texel(int x, int y, vec4_t point_a, vec4_t point_b, vec4_t point_c, tex2_t a_uv_w, tex2_t b_uv_w, tex2_t c_uv_w, upng_t* texture, vec3_t inverse_w, float light_intensity) {
-    vec2_t point_p = { x, y };
-    vec2_t a = vec2_from_vec4(point_a);
-    vec2_t b = vec2_from_vec4(point_b);
-    vec2_t c = vec2_from_vec4(point_c);
-
-    vec3_t weights = barycentric_weights(a, b, c, point_p);
-
-    float alpha = weights.x;
-    float beta = weights.y;
-    float gamma = weights.z;
-
-    float interpolated_u;
-    float interpolated_v;
-    float interpolated_reciprocal_w;
-
-    // Perform the interpolation of all U/w V/w, 1/w values using barycentric weights
-    interpolated_u = (a_uv_w.u) * alpha + (b_uv_w.u) * beta + (c_uv_w.u) * gamma;
-    interpolated_v = (a_uv_w.v) * alpha + (b_uv_w.v) * beta + (c_uv_w.v) * gamma;
-
-    // Perform the interpolation of the reciprocal w
-    interpolated_reciprocal_w = inverse_w.x * alpha + inverse_w.y * beta + inverse_w.z * gamma;
-
-    // Divide the interpolated U and V by the interpolated reciprocal w
-    interpolated_u /= interpolated_reciprocal_w;
-    interpolated_v /= interpolated_reciprocal_w;
-
-    // Map the UV coordinate to the full texture width and height + clipping if error
-    int texture_width = upng_get_width(texture);
-    int texture_height = upng_get_height(texture);
-    int tex_x = abs((int)(interpolated_u * texture_width)) % texture_width;
-    int tex_y = abs((int)(interpolated_v * texture_height)) % texture_height;
-    
-    // Adjust 1/w value
-    interpolated_reciprocal_w = 1.0 - interpolated_reciprocal_w;
-
-    int position_texture = (tex_y * texture_width) + tex_x;
-    if (interpolated_reciprocal_w < get_z_buffer(x, y)) {
-        // Draw the pixel with the color from the texture
-        uint32_t* texture_buffer = (uint32_t*)upng_get_buffer(texture);
-        draw_pixel(x, y, shade_color(texture_buffer[position_texture], light_intensity));
-        // Update the z_buffer for the current pixel
-        update_z_buffer(x, y, interpolated_reciprocal_w);
+// Affine spans ===============================================================
+
+/*
+* Quake style texture mapping: the uv are perspective correct every SPAN_SIZE
+* pixels and interpolated affinely (16.16 fixed point) in between, so most
+* pixels skip the divide. Spans are aligned on absolute x so a span never
+* straddles a tile (TILE_SIZE is a multiple of SPAN_SIZE): the output does
+* not depend on the tiling.
+*/
+#define SPAN_SIZE 16
+#define FIXED_ONE 65536.0f
+// Triangles with almost the same w everywhere are mapped fully affine
+#define AFFINE_W_RATIO 1.01f
+
+// Covered pixels of a row: the edge functions are linear so it is one interval
+static bool row_coverage(const raster_setup_t* setup, const int w_row[3], int* first, int* last) {
+    int x_first = setup->x_min;
+    int x_last = setup->x_max;
+    for (int i = 0; i < 3; i++) {
+        // Inside while w + step * (x - x_min) >= 0
+        long long w = (long long)w_row[i] - setup->threshold[i];
+        long long step = setup->step_x[i];
+        if (step == 0) {
+            if (w < 0) return false;
+        } else if (step > 0) {
+            if (w < 0) x_first = MAX(x_first, setup->x_min + (int)((-w + step - 1) / step));
+        } else {
+            if (w < 0) return false;
+            x_last = MIN(x_last, setup->x_min + (int)(w / -step));
+        }
     }
+    *first = x_first;
+    *last = x_last;
+    return x_first <= x_last;
 }
 
-// Exposed function ==========================================================
-
-void draw_filled_triangle(triangle_t triangle, color_t color) {
-    // Order the triangle
-    order_triangle_by_y(&triangle);
-    // Extract the coordinates so its easier to work with
-    int x0 = triangle.points[0].data[0];
-    int y0 = triangle.points[0].data[1];
-    int x1 = triangle.points[1].data[0];
-    int y1 = triangle.points[1].data[1];
-    int x2 = triangle.points[2].data[0];
-    int y2 = triangle.points[2].data[1];
-
-    // Vector points
-    vec4_t point_a = triangle.points[0];
-    vec4_t point_b = triangle.points[1];
-    vec4_t point_c = triangle.points[2];
-    vec3_t inverse_w = { .x = 1 / point_a.data[3], .y = 1 / point_b.data[3], .z = 1 / point_c.data[3] };
-
-    // Render the upper part of the triangle
-    // =====================================
-    float inv_slope_1 = 0;
-    float inv_slope_2 = 0;
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-    if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; y++) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_start > x_end) {
-                int_swap(&x_start, &x_end);
-            }
-
-            for (int x = x_start; x <= x_end; x++) {
-                draw_triangle_pixel(
-                    x, y,
-                    point_a,
-                    point_b,
-                    point_c,
-                    &color,
-                    inverse_w,
-                    triangle.light_intensity
-                );
-            }
+SPECIALISED void draw_textured_spans(
+    const raster_setup_t* setup, const triangle_t* triangle,
+    const float inverse_w[3], const attribute_plane_t* inverse_w_plane,
+    const attribute_plane_t* u_w_plane, const attribute_plane_t* v_w_plane,
+    const texture_level_t* texture, bool is_bilinear,
+    const depth_range_t* depth_range, int depth_format
+) {
+    // Fully affine: u and v are planes in screen space, no divide at all
+    float min_inverse_w = MIN(inverse_w[0], MIN(inverse_w[1], inverse_w[2]));
+    float max_inverse_w = MAX(inverse_w[0], MAX(inverse_w[1], inverse_w[2]));
+    bool is_affine = max_inverse_w < min_inverse_w * AFFINE_W_RATIO;
+    attribute_plane_t u_plane;
+    attribute_plane_t v_plane;
+    if (is_affine) {
+        float u[3];
+        float v[3];
+        for (int i = 0; i < 3; i++) {
+            u[i] = triangle->tex_coords[setup->vertex_order[i]].u * texture->width;
+            v[i] = triangle->tex_coords[setup->vertex_order[i]].v * texture->height;
         }
+        u_plane = setup_attribute_plane(setup, u);
+        v_plane = setup_attribute_plane(setup, v);
     }
 
-    // Render the lower part of the triangle
-    // =====================================
-    inv_slope_1 = 0;
-    inv_slope_2 = 0;
-
-    if (y2 - y1 != 0) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-
-    if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; y++) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        int x_first;
+        int x_last;
+        bool is_covered = row_coverage(setup, w_row, &x_first, &x_last);
+        for (int i = 0; i < 3; i++) {
+            w_row[i] += setup->step_y[i];
+        }
+        if (!is_covered) {
+            continue;
+        }
 
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
+        color_t* color_row = get_color_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        int y_offset = y - setup->y_anchor;
+        float inverse_w_row = attribute_plane_row(inverse_w_plane, y_offset);
+        float u_w_row = attribute_plane_row(is_affine ? &u_plane : u_w_plane, y_offset);
+        float v_w_row = attribute_plane_row(is_affine ? &v_plane : v_w_plane, y_offset);
+
+        int span_start = x_first;
+        while (span_start <= x_last) {
+            int span_end = MIN(span_start | (SPAN_SIZE - 1), x_last);
+
+            // Texel coordinates (16.16) at both ends of the span
+            int fixed_u[2];
+            int fixed_v[2];
+            int ends[2] = { span_start, span_end };
+            for (int e = 0; e < 2; e++) {
+                float offset_x = ends[e] - setup->x_anchor;
+                float u = u_w_row + (is_affine ? u_plane.dx : u_w_plane->dx) * offset_x;
+                float v = v_w_row + (is_affine ? v_plane.dx : v_w_plane->dx) * offset_x;
+                if (!is_affine) {
+                    float w = 1.0f / (inverse_w_row + inverse_w_plane->dx * offset_x);
+                    u *= w * texture->width;
+                    v *= w * texture->height;
+                }
+                fixed_u[e] = (int)(u * FIXED_ONE);
+                fixed_v[e] = (int)(v * FIXED_ONE);
             }
-
-            for (int x = x_start; x < x_end; x++) {
-                draw_triangle_pixel(
-                    x, y,
-                    point_a,
-                    point_b,
-                    point_c,
-                    &color,
-                    inverse_w,
-                    triangle.light_intensity
-                );
+            int span_length = MAX(span_end - span_start, 1);
+            int step_u = (fixed_u[1] - fixed_u[0]) / span_length;
+            int step_v = (fixed_v[1] - fixed_v[0]) / span_length;
+
+            int current_u = fixed_u[0];
+            int current_v = fixed_v[0];
+            float offset_x = span_start - setup->x_anchor;
+            for (int x = span_start; x <= span_end; x++) {
+                float reciprocal_w = inverse_w_row + inverse_w_plane->dx * offset_x;
+                if (depth_test(z_row, x, reciprocal_w, depth_range, depth_format)) {
+                    uint32_t texel;
+                    if (is_bilinear) {
+                        // Texel centers at half integers, the 8 bits below the texel are the weights
+                        int texel_u = current_u - (1 << 15);
+                        int texel_v = current_v - (1 << 15);
+                        texel = texture_fetch_bilinear(texture, texel_u >> 16, texel_v >> 16, (texel_u >> 8) & 0xFF, (texel_v >> 8) & 0xFF);
+                    } else {
+                        texel = texture_fetch(texture, current_u >> 16, current_v >> 16);
+                    }
+                    color_row[x] = shade_color(texel, triangle->light_intensity);
+                }
+                current_u += step_u;
+                current_v += step_v;
+                offset_x += 1.0f;
             }
+            span_start = span_end + 1;
         }
     }
 }
 
-// Draw a triangle with texture
-void draw_textured_triangle(triangle_t triangle) {
-
-    order_triangle_by_y(&triangle);
-    // Extract the coordinates so its easier to work with
-    int x0 = triangle.points[0].data[0];
-    int y0 = triangle.points[0].data[1];
-    int x1 = triangle.points[1].data[0];
-    int y1 = triangle.points[1].data[1];
-    int x2 = triangle.points[2].data[0];
-    int y2 = triangle.points[2].data[1];
-    tex2_t a_uv = triangle.tex_coords[0];
-    tex2_t b_uv = triangle.tex_coords[1];
-    tex2_t c_uv = triangle.tex_coords[2];
-
-    // Vector points
-    vec4_t point_a = triangle.points[0];
-    vec4_t point_b = triangle.points[1];
-    vec4_t point_c = triangle.points[2];
-
-    tex2_t a_uv_w = { .u = a_uv.u / point_a.data[3], .v = a_uv.v / point_a.data[3] };
-    tex2_t b_uv_w = { .u = b_uv.u / point_b.data[3], .v = b_uv.v / point_b.data[3] };
-    tex2_t c_uv_w = { .u = c_uv.u / point_c.data[3], .v = c_uv.v / point_c.data[3] };
-    vec3_t inverse_w = { .x = 1 / point_a.data[3], .y = 1 / point_b.data[3], .z = 1 / point_c.data[3] };
-
-    // Render the upper part of the triangle
-    // =====================================
-    float inv_slope_1 = 0;
-    float inv_slope_2 = 0;
-    if (y1 - y0 != 0) inv_slope_1 = (float)(x1 - x0) / abs(y1 - y0);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
-    if (y1 - y0 != 0) {
-        for (int y = y0; y <= y1; y++) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
-
-            if (x_start > x_end) {
-                int_swap(&x_start, &x_end);
+// Scalar loops ===============================================================
+
+SPECIALISED void fill_flat(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w_plane, color_t shaded_color,
+    const depth_range_t* depth_range, int depth_format
+) {
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        float inverse_w_row = attribute_plane_row(inverse_w_plane, y - setup->y_anchor);
+        float offset_x = setup->x_min - setup->x_anchor;
+        int w0 = w_row[0];
+        int w1 = w_row[1];
+        int w2 = w_row[2];
+
+        for (int x = setup->x_min; x <= setup->x_max; x++) {
+            if (w0 >= setup->threshold[0] && w1 >= setup->threshold[1] && w2 >= setup->threshold[2]) {
+                // Interpolated reciprocal w to find the depth value
+                float reciprocal_w = inverse_w_row + inverse_w_plane->dx * offset_x;
+                if (depth_test(z_row, x, reciprocal_w, depth_range, depth_format)) {
+                    color_row[x] = shaded_color;
+                }
             }
+            offset_x += 1.0f;
+            w0 += setup->step_x[0];
+            w1 += setup->step_x[1];
+            w2 += setup->step_x[2];
+        }
+
+        w_row[0] += setup->step_y[0];
+        w_row[1] += setup->step_y[1];
+        w_row[2] += setup->step_y[2];
+    }
+}
 
-            for (int x = x_start; x <= x_end; x++) {
-                draw_texel(x, y, point_a, point_b, point_c, a_uv_w, b_uv_w, c_uv_w, triangle.texture, inverse_w, triangle.light_intensity);
+SPECIALISED void fill_textured(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w_plane,
+    const attribute_plane_t* u_w_plane, const attribute_plane_t* v_w_plane,
+    const texture_level_t* texture, bool is_bilinear, float light_intensity,
+    const depth_range_t* depth_range, int depth_format
+) {
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        float inverse_w_row = attribute_plane_row(inverse_w_plane, y - setup->y_anchor);
+        float u_w_row = attribute_plane_row(u_w_plane, y - setup->y_anchor);
+        float v_w_row = attribute_plane_row(v_w_plane, y - setup->y_anchor);
+        float offset_x = setup->x_min - setup->x_anchor;
+        int w0 = w_row[0];
+        int w1 = w_row[1];
+        int w2 = w_row[2];
+
+        for (int x = setup->x_min; x <= setup->x_max; x++) {
+            if (w0 >= setup->threshold[0] && w1 >= setup->threshold[1] && w2 >= setup->threshold[2]) {
+                // Interpolated reciprocal w
+                float interpolated_reciprocal_w = inverse_w_row + inverse_w_plane->dx * offset_x;
+
+                // Depth test first: occluded texels are never fetched
+                if (depth_test(z_row, x, interpolated_reciprocal_w, depth_range, depth_format)) {
+                    // Interpolated U/w V/w divided by the interpolated 1/w
+                    float w = 1.0f / interpolated_reciprocal_w;
+                    float interpolated_u = (u_w_row + u_w_plane->dx * offset_x) * w;
+                    float interpolated_v = (v_w_row + v_w_plane->dx * offset_x) * w;
+
+                    uint32_t texel = is_bilinear
+                        ? texture_sample_bilinear(texture, interpolated_u, interpolated_v)
+                        : texture_sample_nearest(texture, interpolated_u, interpolated_v);
+                    color_row[x] = shade_color(texel, light_intensity);
+                }
             }
+            offset_x += 1.0f;
+            w0 += setup->step_x[0];
+            w1 += setup->step_x[1];
+            w2 += setup->step_x[2];
         }
+
+        w_row[0] += setup->step_y[0];
+        w_row[1] += setup->step_y[1];
+        w_row[2] += setup->step_y[2];
     }
+}
+
+// Exposed function ==========================================================
 
-    // Render the lower part of the triangle
-    // =====================================
-    inv_slope_1 = 0;
-    inv_slope_2 = 0;
+void draw_filled_triangle(triangle_t triangle, color_t color, const raster_settings_t* settings) {
+    raster_setup_t setup;
+    if (!setup_triangle(&triangle, &setup, settings)) {
+        return;
+    }
 
-    if (y2 - y1 != 0) inv_slope_1 = (float)(x2 - x1) / abs(y2 - y1);
-    if (y2 - y0 != 0) inv_slope_2 = (float)(x2 - x0) / abs(y2 - y0);
+    // Plane of 1/w, from the attributes of the vertices in the order of the edges
+    float inverse_w[3];
+    for (int i = 0; i < 3; i++) {
+        inverse_w[i] = 1 / triangle.points[setup.vertex_order[i]].data[3];
+    }
+    attribute_plane_t inverse_w_plane = setup_attribute_plane(&setup, inverse_w);
+    // The shading is constant over the triangle (flat shading)
+    color_t shaded_color = shade_color(color, triangle.light_intensity);
+    const depth_range_t* depth_range = &settings->depth_range;
+
+    if (raster_use_avx2(settings)) {
+        raster_flat_avx2(&setup, &inverse_w_plane, shaded_color, depth_range, settings->depth_format);
+        return;
+    }
+    DEPTH_FORMAT_DISPATCH(settings->depth_format, fill_flat, &setup, &inverse_w_plane, shaded_color, depth_range);
+}
 
-    if (y2 - y1 != 0) {
-        for (int y = y1; y <= y2; y++) {
-            int x_start = x1 + (y - y1) * inv_slope_1;
-            int x_end = x0 + (y - y0) * inv_slope_2;
+// Draw a triangle with texture
+void draw_textured_triangle(triangle_t triangle, const raster_settings_t* settings) {
+    if (triangle.texture == NULL) {
+        // Mesh loaded without a png, fallback on the face color
+        draw_filled_triangle(triangle, triangle.color, settings);
+        return;
+    }
 
-            if (x_end < x_start) {
-                int_swap(&x_start, &x_end); // swap if x_start is to the right of x_end
-            }
+    raster_setup_t setup;
+    if (!setup_triangle(&triangle, &setup, settings)) {
+        return;
+    }
 
-            for (int x = x_start; x < x_end; x++) {
-                // Draw our pixel with the color that comes from the texture
-                draw_texel(x, y, point_a, point_b, point_c, a_uv_w, b_uv_w, c_uv_w, triangle.texture, inverse_w, triangle.light_intensity);
-            }
-        }
+    // Planes of 1/w, u/w and v/w, from the attributes of the vertices in the order of the edges
+    float inverse_w[3];
+    float u_w[3];
+    float v_w[3];
+    for (int i = 0; i < 3; i++) {
+        int vertex = setup.vertex_order[i];
+        inverse_w[i] = 1 / triangle.points[vertex].data[3];
+        u_w[i] = triangle.tex_coords[vertex].u * inverse_w[i];
+        v_w[i] = triangle.tex_coords[vertex].v * inverse_w[i];
+    }
+    attribute_plane_t inverse_w_plane = setup_attribute_plane(&setup, inverse_w);
+    attribute_plane_t u_w_plane = setup_attribute_plane(&setup, u_w);
+    attribute_plane_t v_w_plane = setup_attribute_plane(&setup, v_w);
+    const texture_level_t* texture = select_texture_level(&triangle, settings);
+    bool is_bilinear = settings->filter_mode == FILTER_BILINEAR;
+    const depth_range_t* depth_range = &settings->depth_range;
+
+    if (settings->mapping_mode == MAPPING_AFFINE_SPAN) {
+        DEPTH_FORMAT_DISPATCH(settings->depth_format, draw_textured_spans,
+            &setup, &triangle, inverse_w, &inverse_w_plane, &u_w_plane, &v_w_plane, texture, is_bilinear, depth_range);
+        return;
+    }
+    if (raster_use_avx2(settings)) {
+        raster_textured_avx2(&setup, &inverse_w_plane, &u_w_plane, &v_w_plane, texture, is_bilinear, triangle.light_intensity, depth_range, settings->depth_format);
+        return;
     }
+    DEPTH_FORMAT_DISPATCH(settings->depth_format, fill_textured,
+        &setup, &inverse_w_plane, &u_w_plane, &v_w_plane, texture, is_bilinear, triangle.light_intensity, depth_range);
 }
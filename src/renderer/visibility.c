@@ -0,0 +1,155 @@
+#include "visibility.h"
+#include "array.h"
+#include "display.h"
+#include "light.h"
+#include "raster.h"
+#include "triangle.h"
+#include "texture.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// What pass two needs to shade a pixel of a triangle
+typedef struct {
+    attribute_plane_t inverse_w;
+    attribute_plane_t u_w;
+    attribute_plane_t v_w;
+    int x_anchor, y_anchor;
+    const texture_level_t* texture;  // NULL: flat color
+    color_t shaded_color;
+    float light_intensity;
+    bool is_visible;
+} visibility_triangle_t;
+
+static triangle_t* frame_triangles = NULL;
+static visibility_triangle_t* visibility_triangles = NULL;  // Dynamic array, one per triangle
+
+void prepare_visibility_buffer(triangle_t* triangles, int num_triangles, const raster_settings_t* settings) {
+    frame_triangles = triangles;
+    array_reset(visibility_triangles);
+    if (num_triangles > 0) {
+        visibility_triangles = array_hold(visibility_triangles, num_triangles, sizeof(visibility_triangle_t));
+    }
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < num_triangles; i++) {
+        triangle_t* triangle = &triangles[i];
+        visibility_triangle_t* visibility = &visibility_triangles[i];
+        raster_setup_t setup;
+        // The planes do not depend on the clip rect: any thread can set them up
+        visibility->is_visible = setup_triangle(triangle, &setup, settings);
+        if (!visibility->is_visible) {
+            continue;
+        }
+
+        float inverse_w[3];
+        float u_w[3];
+        float v_w[3];
+        for (int j = 0; j < 3; j++) {
+            int vertex = setup.vertex_order[j];
+            inverse_w[j] = 1 / triangle->points[vertex].data[3];
+            u_w[j] = triangle->tex_coords[vertex].u * inverse_w[j];
+            v_w[j] = triangle->tex_coords[vertex].v * inverse_w[j];
+        }
+        visibility->inverse_w = setup_attribute_plane(&setup, inverse_w);
+        visibility->u_w = setup_attribute_plane(&setup, u_w);
+        visibility->v_w = setup_attribute_plane(&setup, v_w);
+        visibility->x_anchor = setup.x_anchor;
+        visibility->y_anchor = setup.y_anchor;
+        visibility->light_intensity = triangle->light_intensity;
+        visibility->shaded_color = shade_color(triangle->color, triangle->light_intensity);
+        visibility->texture = triangle->texture != NULL ? select_texture_level(triangle, settings) : NULL;
+    }
+}
+
+void free_visibility_buffer(void) {
+    array_free(visibility_triangles);
+    visibility_triangles = NULL;
+    frame_triangles = NULL;
+}
+
+SPECIALISED void fill_visibility(
+    const raster_setup_t* setup, const attribute_plane_t* inverse_w_plane, uint32_t id,
+    const depth_range_t* depth_range, int depth_format
+) {
+    int w_row[3] = { setup->w_row[0], setup->w_row[1], setup->w_row[2] };
+    for (int y = setup->y_min; y <= setup->y_max; y++) {
+        uint32_t* id_row = get_id_buffer_row(y);
+        void* z_row = get_z_buffer_row(y, depth_format);
+        float inverse_w_row = attribute_plane_row(inverse_w_plane, y - setup->y_anchor);
+        float offset_x = setup->x_min - setup->x_anchor;
+        int w0 = w_row[0];
+        int w1 = w_row[1];
+        int w2 = w_row[2];
+
+        for (int x = setup->x_min; x <= setup->x_max; x++) {
+            if (w0 >= setup->threshold[0] && w1 >= setup->threshold[1] && w2 >= setup->threshold[2]) {
+                float reciprocal_w = inverse_w_row + inverse_w_plane->dx * offset_x;
+                if (depth_test(z_row, x, reciprocal_w, depth_range, depth_format)) {
+                    id_row[x] = id;
+                }
+            }
+            offset_x += 1.0f;
+            w0 += setup->step_x[0];
+            w1 += setup->step_x[1];
+            w2 += setup->step_x[2];
+        }
+
+        w_row[0] += setup->step_y[0];
+        w_row[1] += setup->step_y[1];
+        w_row[2] += setup->step_y[2];
+    }
+}
+
+void draw_visibility_triangle(triangle_t* triangle, const raster_settings_t* settings) {
+    uint32_t id = (uint32_t)(triangle - frame_triangles);
+    const visibility_triangle_t* visibility = &visibility_triangles[id];
+    raster_setup_t setup;
+    if (!visibility->is_visible || !setup_triangle(triangle, &setup, settings)) {
+        return;
+    }
+
+    const depth_range_t* depth_range = &settings->depth_range;
+    if (raster_use_avx2(settings)) {
+        raster_visibility_avx2(&setup, &visibility->inverse_w, id, depth_range, settings->depth_format);
+        return;
+    }
+    DEPTH_FORMAT_DISPATCH(settings->depth_format, fill_visibility, &setup, &visibility->inverse_w, id, depth_range);
+}
+
+void shade_visibility_buffer(const raster_settings_t* settings) {
+    int width = get_window_width();
+    int height = get_window_height();
+    bool is_bilinear = settings->filter_mode == FILTER_BILINEAR;
+    int depth_format = settings->depth_format;
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int y = 0; y < height; y++) {
+        color_t* color_row = get_color_buffer_row(y);
+        const void* z_row = get_z_buffer_row(y, depth_format);
+        uint32_t* id_row = get_id_buffer_row(y);
+
+        for (int x = 0; x < width; x++) {
+            // Only the covered pixels have a valid index
+            if (depth_is_cleared(z_row, x, depth_format)) {
+                continue;
+            }
+            const visibility_triangle_t* visibility = &visibility_triangles[id_row[x]];
+            if (visibility->texture == NULL) {
+                color_row[x] = visibility->shaded_color;
+                continue;
+            }
+
+            // Same interpolation as draw_textured_triangle(): same texel
+            float offset_x = x - visibility->x_anchor;
+            float interpolated_reciprocal_w = attribute_plane_row(&visibility->inverse_w, y - visibility->y_anchor) + visibility->inverse_w.dx * offset_x;
+            float w = 1.0f / interpolated_reciprocal_w;
+            float interpolated_u = (attribute_plane_row(&visibility->u_w, y - visibility->y_anchor) + visibility->u_w.dx * offset_x) * w;
+            float interpolated_v = (attribute_plane_row(&visibility->v_w, y - visibility->y_anchor) + visibility->v_w.dx * offset_x) * w;
+
+            uint32_t texel = is_bilinear
+                ? texture_sample_bilinear(visibility->texture, interpolated_u, interpolated_v)
+                : texture_sample_nearest(visibility->texture, interpolated_u, interpolated_v);
+            color_row[x] = shade_color(texel, visibility->light_intensity);
+        }
+    }
+}
@@ -0,0 +1,402 @@
+/*
+* Golden image and frame time regression tests
+* ---------------------------------------------
+* Renders every scene offscreen in every rendering mode and compares the frames with
+* the references of tests/golden, then benchmarks every scene against a baseline.
+* - Visual: a pixel differs when one channel is off by more than CHANNEL_TOLERANCE,
+*   a frame fails when more than MAX_DIFF_RATIO of its pixels differ.
+* - Raster settings: the texture and visibility modes are also rendered with each
+*   setting off its default (SIMD, subpixel, mapping, mipmap, filter, depth format),
+*   each against its own golden image.
+* - Threads: the frames rendered on 2 and 4 threads, and by the pipelined present,
+*   must be bit-identical to the single thread one.
+* - Frame time: a scene fails when its median frame time is above the baseline by more
+*   than the threshold (the median ignores the odd preempted frame). The baselines are
+*   per machine and configuration: on a machine that did not record them, --warn-timing
+*   only warns, and a scene without a baseline is skipped. Re-record them (and the
+*   golden images after an intended change) with --update.
+*
+* Usage: test_runner ENGINE [--output DIR] [--baseline FILE] [--threshold RATIO] [--warn-timing] [--update]
+* Run from the root of the repository (the engine loads ./assets).
+*/
+#define _POSIX_C_SOURCE 200809L  // setenv()
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
+
+// An empty value removes the variable on Windows
+static void set_environment(const char* name, const char* value) {
+#ifdef _WIN32
+    _putenv_s(name, value != NULL ? value : "");
+#else
+    if (value != NULL) {
+        setenv(name, value, 1);
+    } else {
+        unsetenv(name);
+    }
+#endif
+}
+
+#define GOLDEN_DIR "tests/golden"
+#define FRAME_SIZE "240x150"
+#define CHANNEL_TOLERANCE 8
+#define MAX_DIFF_RATIO 0.001
+#define BENCHMARK_SIZE "640x400"
+#define BENCHMARK_FRAMES 60
+#define DEFAULT_THRESHOLD 0.25
+#define PATH_SIZE 256
+
+static const char* SCENES[] = { "planes", "cube", "sphere", "teapot" };
+static const char* RENDER_MODES[] = {
+    "wireframe", "wireframe_vertex", "triangle", "triangle_wireframe", "texture", "texture_wireframe", "visibility"
+};
+#define NUM_SCENES ((int)(sizeof(SCENES) / sizeof(SCENES[0])))
+#define NUM_RENDER_MODES ((int)(sizeof(RENDER_MODES) / sizeof(RENDER_MODES[0])))
+
+// Runs compared bit for bit with the single thread frame
+typedef struct {
+    const char* name;
+    const char* num_threads;
+    const char* present;
+} thread_variant_t;
+static const thread_variant_t THREAD_VARIANTS[] = {
+    { "2_threads", "2", "update" },
+    { "4_threads", "4", "update" },
+    { "pipelined", "4", "pipelined" },
+};
+#define NUM_THREAD_VARIANTS ((int)(sizeof(THREAD_VARIANTS) / sizeof(THREAD_VARIANTS[0])))
+
+// Raster settings off their default, each with its own golden images
+typedef struct {
+    const char* name;
+    const char* arguments;
+} raster_variant_t;
+static const raster_variant_t RASTER_VARIANTS[] = {
+    { "simd_off", "--simd off" },
+    { "subpixel_off", "--subpixel off" },
+    { "affine_span", "--mapping affine_span" },
+    { "mipmap_off", "--mipmap off" },
+    { "bilinear", "--filter bilinear" },
+    { "depth_unorm16", "--depth unorm16" },
+    { "depth_unorm24", "--depth unorm24" },
+    { "depth_reversed_float", "--depth reversed_float" },
+};
+static const char* RASTER_VARIANT_MODES[] = { "texture", "visibility" };
+#define NUM_RASTER_VARIANTS ((int)(sizeof(RASTER_VARIANTS) / sizeof(RASTER_VARIANTS[0])))
+#define NUM_RASTER_VARIANT_MODES ((int)(sizeof(RASTER_VARIANT_MODES) / sizeof(RASTER_VARIANT_MODES[0])))
+
+typedef struct {
+    const char* engine;
+    const char* output_dir;
+    const char* baseline_path;
+    double threshold;
+    bool is_timing_warning;  // A frame time over the baseline warns instead of failing
+    bool is_update;
+} settings_t;
+
+static int num_passed = 0;
+static int num_failed = 0;
+static int num_warnings = 0;
+
+static void report(bool is_passed, const char* test, const char* detail) {
+    printf("[%s] %s%s%s\n", is_passed ? "PASS" : "FAIL", test, detail[0] ? ": " : "", detail);
+    if (is_passed) {
+        num_passed++;
+    } else {
+        num_failed++;
+    }
+}
+
+// Not counted as a failure
+static void report_warning(const char* test, const char* detail) {
+    printf("[WARN] %s: %s\n", test, detail);
+    num_warnings++;
+}
+
+// Images ---------------------------------------------------------------------
+
+typedef struct {
+    int width;
+    int height;
+    unsigned char* rgb;
+} image_t;
+
+// Binary PPM as written by the engine (no comment in the header)
+static bool load_ppm(const char* path, image_t* image) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    int max_value;
+    bool is_loaded = fscanf(file, "P6 %d %d %d", &image->width, &image->height, &max_value) == 3
+        && max_value == 255 && fgetc(file) != EOF;
+    if (is_loaded) {
+        size_t size = (size_t)3 * image->width * image->height;
+        image->rgb = malloc(size);
+        is_loaded = image->rgb != NULL && fread(image->rgb, 1, size, file) == size;
+        if (!is_loaded) {
+            free(image->rgb);
+        }
+    }
+    fclose(file);
+    return is_loaded;
+}
+
+// Pixels with a channel off by more than the tolerance, -1 if the sizes differ
+static int count_diff_pixels(const image_t* a, const image_t* b, int tolerance) {
+    if (a->width != b->width || a->height != b->height) {
+        return -1;
+    }
+    int num_diff = 0;
+    for (int i = 0; i < a->width * a->height; i++) {
+        for (int channel = 0; channel < 3; channel++) {
+            if (abs(a->rgb[3 * i + channel] - b->rgb[3 * i + channel]) > tolerance) {
+                num_diff++;
+                break;
+            }
+        }
+    }
+    return num_diff;
+}
+
+static bool copy_file(const char* from, const char* to) {
+    FILE* in = fopen(from, "rb");
+    FILE* out = fopen(to, "wb");
+    bool is_copied = in != NULL && out != NULL;
+    char buffer[1 << 16];
+    size_t size;
+    while (is_copied && (size = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+        is_copied = fwrite(buffer, 1, size, out) == size;
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    if (out != NULL) {
+        is_copied = fclose(out) == 0 && is_copied;
+    }
+    return is_copied;
+}
+
+// Engine ---------------------------------------------------------------------
+
+// Run the engine with OpenMP on num_threads threads (NULL: its default)
+static bool run_engine(const settings_t* settings, const char* num_threads, const char* arguments) {
+    set_environment("OMP_NUM_THREADS", num_threads);
+    char command[2048];
+#ifdef _WIN32
+    // cmd.exe strips the first and last quotes of a command with more than two
+    snprintf(command, sizeof(command), "\"\"%s\" %s > " NULL_DEVICE "\"", settings->engine, arguments);
+#else
+    snprintf(command, sizeof(command), "\"%s\" %s > " NULL_DEVICE, settings->engine, arguments);
+#endif
+    return system(command) == 0;
+}
+
+static bool render_frame(const settings_t* settings, const char* scene, const char* mode, const raster_variant_t* raster,
+                         const char* num_threads, const char* present, const char* path) {
+    char arguments[1024];
+    snprintf(
+        arguments, sizeof(arguments), "--offscreen " FRAME_SIZE " --scene %s --render-mode %s %s --present %s --dump \"%s\"",
+        scene, mode, raster != NULL ? raster->arguments : "", present, path
+    );
+    return run_engine(settings, num_threads, arguments);
+}
+
+// Golden images --------------------------------------------------------------
+
+// Raster variant NULL: the default settings
+static void test_render_mode(const settings_t* settings, const char* scene, const char* mode, const raster_variant_t* raster) {
+    char name[128], test[128], detail[1024], path[PATH_SIZE], golden_path[PATH_SIZE];
+    snprintf(name, sizeof(name), "%s_%s%s%s", scene, mode, raster != NULL ? "_" : "", raster != NULL ? raster->name : "");
+    snprintf(test, sizeof(test), "%s/%s%s%s", scene, mode, raster != NULL ? "/" : "", raster != NULL ? raster->name : "");
+    snprintf(path, sizeof(path), "%s/%s.ppm", settings->output_dir, name);
+    snprintf(golden_path, sizeof(golden_path), GOLDEN_DIR "/%s.ppm", name);
+
+    image_t frame;
+    if (!render_frame(settings, scene, mode, raster, "1", "update", path) || !load_ppm(path, &frame)) {
+        report(false, test, "the engine did not render the frame");
+        return;
+    }
+
+    // Against the reference
+    if (settings->is_update) {
+        bool is_copied = copy_file(path, golden_path);
+        report(is_copied, test, is_copied ? "golden image updated" : "cannot write the golden image");
+    } else {
+        image_t golden;
+        if (!load_ppm(golden_path, &golden)) {
+            snprintf(detail, sizeof(detail), "no golden image %s (record it with update=1)", golden_path);
+            report(false, test, detail);
+        } else {
+            int num_diff = count_diff_pixels(&frame, &golden, CHANNEL_TOLERANCE);
+            int max_diff = (int)(MAX_DIFF_RATIO * frame.width * frame.height);
+            if (num_diff < 0) {
+                snprintf(detail, sizeof(detail), "size %dx%d instead of %dx%d", frame.width, frame.height, golden.width, golden.height);
+            } else {
+                snprintf(detail, sizeof(detail), "%d pixels over the tolerance (max %d)", num_diff, max_diff);
+            }
+            report(num_diff >= 0 && num_diff <= max_diff, test, num_diff == 0 ? "" : detail);
+            free(golden.rgb);
+        }
+    }
+
+    // Against the single thread frame
+    for (int i = 0; i < NUM_THREAD_VARIANTS; i++) {
+        const thread_variant_t* variant = &THREAD_VARIANTS[i];
+        char variant_test[192], variant_path[PATH_SIZE];
+        snprintf(variant_test, sizeof(variant_test), "%s/%s", test, variant->name);
+        snprintf(variant_path, sizeof(variant_path), "%s/%s_%s.ppm", settings->output_dir, name, variant->name);
+
+        image_t variant_frame;
+        if (!render_frame(settings, scene, mode, raster, variant->num_threads, variant->present, variant_path)
+            || !load_ppm(variant_path, &variant_frame)) {
+            report(false, variant_test, "the engine did not render the frame");
+            continue;
+        }
+        int num_diff = count_diff_pixels(&variant_frame, &frame, 0);
+        snprintf(detail, sizeof(detail), "%d pixels differ from the single thread frame", num_diff);
+        report(num_diff == 0, variant_test, num_diff == 0 ? "" : detail);
+        free(variant_frame.rgb);
+    }
+    free(frame.rgb);
+}
+
+// Frame times ----------------------------------------------------------------
+
+// Median frame time of a benchmark report, negative if not found
+static double read_median_frame_time(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1.0;
+    }
+    char line[256];
+    double median = -1.0;
+    while (fgets(line, sizeof(line), file)) {
+        const char* key = strstr(line, "\"median\":");
+        if (key != NULL && sscanf(key, "\"median\": %lf", &median) == 1) {
+            break;
+        }
+    }
+    fclose(file);
+    return median;
+}
+
+// Baseline file: one "scene median_ms" per line, negative if the scene is not in it
+static double read_baseline(const char* path, const char* scene) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return -1.0;
+    }
+    char name[64];
+    double frame_time;
+    double baseline = -1.0;
+    while (fscanf(file, "%63s %lf", name, &frame_time) == 2) {
+        if (strcmp(name, scene) == 0) {
+            baseline = frame_time;
+        }
+    }
+    fclose(file);
+    return baseline;
+}
+
+static void test_frame_times(const settings_t* settings) {
+    double medians[NUM_SCENES];
+    for (int i = 0; i < NUM_SCENES; i++) {
+        char test[128], detail[1024], path[PATH_SIZE], arguments[1024];
+        snprintf(test, sizeof(test), "%s/frame_time", SCENES[i]);
+        snprintf(path, sizeof(path), "%s/benchmark_%s.json", settings->output_dir, SCENES[i]);
+        snprintf(
+            arguments, sizeof(arguments), "--benchmark --offscreen " BENCHMARK_SIZE " --scene %s --frames %d --report \"%s\"",
+            SCENES[i], BENCHMARK_FRAMES, path
+        );
+        medians[i] = run_engine(settings, NULL, arguments) ? read_median_frame_time(path) : -1.0;
+        if (medians[i] < 0.0) {
+            report(false, test, "the benchmark did not run");
+            continue;
+        }
+        if (settings->is_update) {
+            continue;
+        }
+
+        double baseline = read_baseline(settings->baseline_path, SCENES[i]);
+        if (baseline < 0.0) {
+            snprintf(detail, sizeof(detail), "%.3f ms, skipped: no baseline in %s (record it with update=1)", medians[i], settings->baseline_path);
+            report_warning(test, detail);
+            continue;
+        }
+        bool is_passed = medians[i] <= baseline * (1.0 + settings->threshold);
+        snprintf(detail, sizeof(detail), "%.3f ms for a baseline of %.3f ms (%+.1f%%)", medians[i], baseline, 100.0 * (medians[i] / baseline - 1.0));
+        if (is_passed || !settings->is_timing_warning) {
+            report(is_passed, test, detail);
+        } else {
+            report_warning(test, detail);
+        }
+    }
+
+    if (settings->is_update) {
+        FILE* file = fopen(settings->baseline_path, "w");
+        for (int i = 0; file != NULL && i < NUM_SCENES; i++) {
+            if (medians[i] >= 0.0) {
+                fprintf(file, "%s %.4f\n", SCENES[i], medians[i]);
+            }
+        }
+        bool is_written = file != NULL && fclose(file) == 0;
+        report(is_written, "frame_time", is_written ? "baseline updated" : "cannot write the baseline");
+    }
+}
+
+// Main -----------------------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s ENGINE [--output DIR] [--baseline FILE] [--threshold RATIO] [--warn-timing] [--update]\n", argv[0]);
+        return 2;
+    }
+    settings_t settings = {
+        .engine = argv[1],
+        .output_dir = ".",
+        .baseline_path = "tests/baseline/frame_times.txt",
+        .threshold = DEFAULT_THRESHOLD,
+        .is_timing_warning = false,
+        .is_update = false
+    };
+    for (int i = 2; i < argc; i++) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--output") == 0 && value != NULL) {
+            settings.output_dir = argv[++i];
+        } else if (strcmp(argv[i], "--baseline") == 0 && value != NULL) {
+            settings.baseline_path = argv[++i];
+        } else if (strcmp(argv[i], "--threshold") == 0 && value != NULL) {
+            settings.threshold = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--warn-timing") == 0) {
+            settings.is_timing_warning = true;
+        } else if (strcmp(argv[i], "--update") == 0) {
+            settings.is_update = true;
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    for (int scene = 0; scene < NUM_SCENES; scene++) {
+        for (int mode = 0; mode < NUM_RENDER_MODES; mode++) {
+            test_render_mode(&settings, SCENES[scene], RENDER_MODES[mode], NULL);
+        }
+        for (int mode = 0; mode < NUM_RASTER_VARIANT_MODES; mode++) {
+            for (int raster = 0; raster < NUM_RASTER_VARIANTS; raster++) {
+                test_render_mode(&settings, SCENES[scene], RASTER_VARIANT_MODES[mode], &RASTER_VARIANTS[raster]);
+            }
+        }
+    }
+    test_frame_times(&settings);
+
+    printf("%d passed, %d failed, %d warnings\n", num_passed, num_failed, num_warnings);
+    return num_failed == 0 ? 0 : 1;
+}